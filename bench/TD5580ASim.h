@@ -0,0 +1,411 @@
+/****************************************************************************************
+*                                                                                       *
+*   TD5580ASim.h - Behavioral simulator of a TD5580A-based DFPlayer Mini clone          *
+*                                                                                       *
+*   Written by Matt Kaufman, December, 2025.                                            *
+*                                                                                       *
+*   Host-side only: plugs into `dfplayer::Driver` through `SimTransport`, in place      *
+*   of `Serial1`, so pacing changes can be measured without the board.                  *
+*                                                                                       *
+*****************************************************************************************/
+
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <deque>
+#include <random>
+#include <vector>
+#include "Commands.h"
+#include "Frame.h"
+
+
+namespace dfplayer::sim
+{
+    /**
+     * Timing model of the chip. Every frame occupies the line for `10 * 10` bit times, then
+     * keeps the chip busy for its command's processing delay (± `jitter_pct`). A frame that
+     * arrives while the chip is busy is lost (or answered with `0x40`, see `error_when_busy`).
+     **/
+    struct Timing {
+        unsigned long baud            = 9600;
+        unsigned long default_ms      = 30;     // Processing delay of commands not listed in `delay_ms`
+        unsigned long delay_ms[256]   = {};     // Per-command processing delay (`0`: use `default_ms`)
+        unsigned      jitter_pct      = 20;     // Random spread of the processing delay (± %)
+        bool          error_when_busy = false;  // Answer a frame that arrives while busy with `0x40`
+        unsigned      error_pct       = 0;      // Frames rejected with `0x40` at random (line noise, %)
+        unsigned long track_ms        = 0;      // Length of every track (`0`: tracks never end)
+        unsigned long reset_ms        = 1500;   // Time until `0x3F` after a reset
+
+        Timing()
+        {
+            delay_ms[cmd::PLAY_N]       = 120;
+            delay_ms[cmd::PLAY_S_LOOP]  = 120;
+            delay_ms[cmd::PLAY_F_FILE]  = 150;
+            delay_ms[cmd::NEXT]         = 120;
+            delay_ms[cmd::PREVIOUS]     = 120;
+            delay_ms[cmd::PLAY_LOOPS]   = 120;
+            delay_ms[cmd::PLAY_SHUFFLE] = 120;
+            delay_ms[cmd::SET_SOURCE]   = 200;
+            delay_ms[cmd::SET_VOL]      = 20;
+            delay_ms[cmd::VOL_UP]       = 20;
+            delay_ms[cmd::VOL_DOWN]     = 20;
+            delay_ms[cmd::RESET]        = 50;
+        }
+
+        // Time one frame takes on the wire, rounded up (ms)
+        unsigned long frame_ms() const
+        {
+            return (frame::SIZE * 10 * 1000 + baud - 1) / baud;
+        }
+    };
+
+
+    /**
+     * The chip: accepts frames from the MCU, applies them after their processing delay, and
+     * answers with `0x41` ACKs, query replies and unsolicited `0x3D` / `0x3F` frames.
+     * Time only moves in `advance()`; everything is deterministic for a given seed.
+     **/
+    class TD5580ASim {
+    public:
+        // Everything the chip holds (what a command's "effect" is checked against)
+        struct Chip {
+            uint8_t  volume        = 30;
+            uint8_t  eq            = 0;
+            uint8_t  source        = 2;
+            uint16_t track         = 1;
+            bool     looping       = false;   // Current track repeats
+            bool     loop_all      = false;   // Playback continues with the next track
+            uint8_t  status        = 0;       // `0`: stopped, `1`: playing, `2`: paused
+            uint16_t total_tracks  = 14;
+            uint16_t folder_count  = 1;
+            uint16_t folder_tracks = 14;
+            bool     booting       = false;   // Restarting after a reset, deaf until `0x3F`
+        };
+
+        // Counters for the benchmark report
+        struct Counters {
+            uint32_t received = 0;   // Valid frames received
+            uint32_t applied  = 0;   // Frames processed
+            uint32_t lost     = 0;   // Frames that arrived while busy
+            uint32_t rejected = 0;   // Frames answered with `0x40` at random (see `Timing::error_pct`)
+            uint32_t corrupt  = 0;   // Bytes discarded while looking for a frame
+        };
+
+        explicit TD5580ASim(const Timing& timing = Timing(), uint32_t seed = 1)
+            : _timing(timing), _rng(seed) {}
+
+        const Chip&     chip()     const { return _chip; }
+        Chip&           chip()           { return _chip; }
+        const Counters& counters() const { return _counters; }
+        const Timing&   timing()   const { return _timing; }
+        unsigned long   now_ms()   const { return _now; }
+
+        void set_delay(uint8_t command, unsigned long ms) { _timing.delay_ms[command] = ms; }
+        void set_baud(unsigned long baud)                 { _timing.baud = baud; }
+
+
+        /**
+         * Bytes written by the MCU. Each complete frame reaches the chip one frame time later.
+         * @param buf The bytes.
+         * @param len The number of bytes.
+         **/
+        void write(const uint8_t* buf, size_t len)
+        {
+            for (size_t i = 0; i < len; i++) {
+                _assemble(buf[i]);
+            }
+        }
+
+        // Bytes from the chip that have fully arrived at the MCU
+        int available() const
+        {
+            size_t count = 0;
+            for (const Outgoing& out : _tx) {
+                if (out.ready_ms > _now) {
+                    break;
+                }
+                count += frame::SIZE - out.pos;
+            }
+            return static_cast<int>(count);
+        }
+
+        int read()
+        {
+            if (_tx.empty() || _tx.front().ready_ms > _now) {
+                return -1;
+            }
+            Outgoing& out = _tx.front();
+            const uint8_t b = out.frame.bytes[out.pos++];
+            if (out.pos == frame::SIZE) {
+                _tx.pop_front();
+            }
+            return b;
+        }
+
+
+        /**
+         * Cuts the chip's power for a while: it forgets its state, ignores every frame until
+         * it has booted again (`off_ms` plus `Timing::reset_ms`), then sends `0x3F`.
+         * @param off_ms How long the power is off.
+         **/
+        void power_glitch(unsigned long off_ms)
+        {
+            _restart(off_ms + _timing.reset_ms);
+        }
+
+
+        /**
+         * Moves simulated time forward, one millisecond at a time.
+         * @param ms The time to advance.
+         **/
+        void advance(unsigned long ms = 1)
+        {
+            while (ms-- > 0) {
+                _now++;
+                _step();
+            }
+        }
+
+    private:
+        struct Incoming {
+            uint8_t       command;
+            uint8_t       ack;
+            uint8_t       data1;
+            uint8_t       data2;
+            unsigned long arrive_ms;
+        };
+
+        struct Outgoing {
+            frame::Frame  frame;
+            unsigned long ready_ms;
+            uint8_t       pos = 0;
+        };
+
+        Timing        _timing;
+        std::mt19937  _rng;
+        unsigned long _now = 0;
+
+        Chip     _chip;
+        Counters _counters;
+
+        uint8_t _rx_buf[frame::SIZE];
+        uint8_t _rx_len = 0;
+
+        std::deque<Incoming> _rx;              // Frames on the wire towards the chip
+        std::deque<Outgoing> _tx;              // Frames on the wire towards the MCU
+        bool          _busy       = false;
+        Incoming      _current    = {};        // Frame being processed
+        unsigned long _done_ms    = 0;         // When `_current` takes effect
+        unsigned long _line_free  = 0;         // When the chip's TX line is free again
+        unsigned long _track_end  = 0;         // When the current track ends (`0`: not playing)
+        unsigned long _boot_end   = 0;         // When the chip is back after a reset
+
+
+        void _assemble(uint8_t b)
+        {
+            if (_rx_len == 0 && b != frame::HEAD) {
+                _counters.corrupt++;
+                return;
+            }
+            _rx_buf[_rx_len++] = b;
+            if (_rx_len < frame::SIZE) {
+                return;
+            }
+            _rx_len = 0;
+
+            const uint16_t sum = (_rx_buf[7] << 8) | _rx_buf[8];
+            if (_rx_buf[1] != frame::VERSION || _rx_buf[2] != frame::LENGTH || _rx_buf[9] != frame::END ||
+                sum != frame::checksum(_rx_buf[3], _rx_buf[4], _rx_buf[5], _rx_buf[6])) {
+                _counters.corrupt += frame::SIZE;
+                return;
+            }
+            _counters.received++;
+            _rx.push_back({ _rx_buf[3], _rx_buf[4], _rx_buf[5], _rx_buf[6], _now + _timing.frame_ms() });
+        }
+
+        void _send(uint8_t command, uint16_t param)
+        {
+            const unsigned long start = _line_free > _now ? _line_free : _now;
+            _line_free = start + _timing.frame_ms();
+            _tx.push_back({ frame::make(command, param >> 8, param & 0xFF), _line_free });
+        }
+
+        unsigned long _delay_of(uint8_t command)
+        {
+            const unsigned long base = _timing.delay_ms[command] ? _timing.delay_ms[command] : _timing.default_ms;
+            if (_timing.jitter_pct == 0) {
+                return base;
+            }
+            const long spread = static_cast<long>(base * _timing.jitter_pct / 100);
+            std::uniform_int_distribution<long> jitter(-spread, spread);
+            return static_cast<unsigned long>(static_cast<long>(base) + jitter(_rng));
+        }
+
+        void _step()
+        {
+            while (!_rx.empty() && _rx.front().arrive_ms <= _now) {
+                const Incoming in = _rx.front();
+                _rx.pop_front();
+
+                if (_timing.error_pct != 0 && !_chip.booting && _rng() % 100 < _timing.error_pct) {
+                    _counters.rejected++;
+                    _send(cmd::ERROR_RESEND, 0);
+                    continue;
+                }
+
+                if (_busy || _chip.booting) {
+                    _counters.lost++;
+                    if (_timing.error_when_busy && !_chip.booting) {
+                        _send(cmd::ERROR_RESEND, 0);
+                    }
+                    continue;
+                }
+                _busy    = true;
+                _current = in;
+                _done_ms = _now + _delay_of(in.command);
+            }
+
+            if (_busy && _now >= _done_ms) {
+                _busy = false;
+                _counters.applied++;
+                _apply(_current);
+            }
+
+            if (_chip.booting && _now >= _boot_end) {
+                _chip.booting = false;
+                _send(cmd::SEND_INIT_PARAMS, cmd::STS_SD_CARD_ONLINE);
+            }
+
+            if (_track_end != 0 && _now >= _track_end) {
+                _end_of_track();
+            }
+        }
+
+        // Back to power-on defaults (same card), deaf until `0x3F`
+        void _restart(unsigned long boot_ms)
+        {
+            const uint16_t total = _chip.total_tracks;
+            _chip = Chip();
+            _chip.total_tracks  = total;
+            _chip.folder_tracks = total;
+            _chip.status  = 0;
+            _chip.booting = true;
+            _boot_end     = _now + boot_ms;
+            _track_end    = 0;
+            _busy         = false;
+        }
+
+        void _start_track(uint16_t track)
+        {
+            _chip.track  = track;
+            _chip.status = 1;
+            _track_end   = _timing.track_ms ? _now + _timing.track_ms : 0;
+        }
+
+        void _end_of_track()
+        {
+            _send(cmd::QU_TF_SD_COMPL, _chip.track);
+
+            if (_chip.looping) {
+                _start_track(_chip.track);
+            }
+            else if (_chip.loop_all) {
+                _start_track(_chip.track >= _chip.total_tracks ? 1 : _chip.track + 1);
+            }
+            else {
+                _chip.status = 0;
+                _track_end   = 0;
+            }
+        }
+
+        void _apply(const Incoming& in)
+        {
+            const uint16_t data = (in.data1 << 8) | in.data2;
+            bool reply = false;
+
+            switch (in.command)
+            {
+                case cmd::NEXT:
+                    _start_track(_chip.track >= _chip.total_tracks ? 1 : _chip.track + 1);
+                    break;
+                case cmd::PREVIOUS:
+                    _start_track(_chip.track <= 1 ? _chip.total_tracks : _chip.track - 1);
+                    break;
+                case cmd::PLAY_N:
+                    _chip.looping = false;
+                    _start_track(data);
+                    break;
+                case cmd::PLAY_S_LOOP:
+                    _chip.looping = true;
+                    _start_track(data);
+                    break;
+                case cmd::PLAY_F_FILE:
+                    _chip.looping = false;
+                    _start_track(in.data2);
+                    break;
+                case cmd::PLAY_LOOPS:
+                case cmd::FOLDER_CYCLE:
+                    _chip.looping  = false;
+                    _chip.loop_all = true;
+                    _start_track(1);
+                    break;
+                case cmd::PLAY_SHUFFLE:
+                    _chip.loop_all = true;
+                    _start_track(1 + _rng() % _chip.total_tracks);
+                    break;
+                case cmd::VOL_UP:     if (_chip.volume < 30) _chip.volume++;  break;
+                case cmd::VOL_DOWN:   if (_chip.volume > 0)  _chip.volume--;  break;
+                case cmd::SET_VOL:    _chip.volume = in.data2 > 30 ? 30 : in.data2;  break;
+                case cmd::SET_EQ:     _chip.eq     = in.data2 > 6 ? 0 : in.data2;    break;
+                case cmd::SET_SOURCE: _chip.source = in.data2;                       break;
+                case cmd::SET_SPLAY:  _chip.looping = (in.data2 == 1);               break;
+                case cmd::PLAY:
+                    _chip.status = 1;
+                    if (_timing.track_ms && _track_end == 0) _track_end = _now + _timing.track_ms;
+                    break;
+                case cmd::PAUSE:
+                    _chip.status = 2;
+                    break;
+                case cmd::STOP_PLAY:
+                    _chip.status = 0;
+                    _track_end   = 0;
+                    break;
+                case cmd::RESET:
+                    _restart(_timing.reset_ms);
+                    return;   // No ACK: the chip is restarting
+
+                case cmd::QRY_STATUS:          reply = true; _send(in.command, _chip.status);         break;
+                case cmd::QRY_VOLUME:          reply = true; _send(in.command, _chip.volume);         break;
+                case cmd::QRY_EQUALIZATION:    reply = true; _send(in.command, _chip.eq);             break;
+                case cmd::QRY_TOTAL_FILES_TFC: reply = true; _send(in.command, _chip.total_tracks);   break;
+                case cmd::QRY_TRACK_SD_CARD:   reply = true; _send(in.command, _chip.track);          break;
+                case cmd::QUERY_FLDR_TRACKS:   reply = true; _send(in.command, _chip.folder_tracks);  break;
+                case cmd::QUERY_FLDR_COUNT:    reply = true; _send(in.command, _chip.folder_count);   break;
+            }
+
+            if (in.ack == frame::ACK && !reply) {
+                _send(cmd::RESPONSE, 0);
+            }
+        }
+    };
+
+
+    /**
+     * `dfplayer::Driver` transport backed by the simulator (see the policy in `Driver.h`).
+     **/
+    class SimTransport {
+    public:
+        explicit SimTransport(TD5580ASim& sim, bool verbose = false) : _sim(sim), _verbose(verbose) {}
+
+        size_t        write(const uint8_t* buf, size_t len) { _sim.write(buf, len); return len; }
+        int           available()                           { return _sim.available(); }
+        int           read()                                { return _sim.read(); }
+        unsigned long now_ms()                              { return _sim.now_ms(); }
+        void          debug(const char* line)               { if (_verbose) printf("[%8lu] %s\n", _sim.now_ms(), line); }
+
+    private:
+        TD5580ASim& _sim;
+        bool        _verbose;
+    };
+}
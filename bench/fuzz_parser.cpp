@@ -0,0 +1,333 @@
+/****************************************************************************************
+*                                                                                       *
+*   fuzz_parser.cpp - Fault-injection and fuzz harness for `dfplayer::Parser`           *
+*                                                                                       *
+*   Written by Matt Kaufman, December, 2025.                                            *
+*                                                                                       *
+*   Feeds the response parser streams of valid frames mixed with line noise: frames     *
+*   damaged in place (dropped bytes, bit flips, bad header/version/length/end bytes,    *
+*   noise spliced in, truncation into the next frame) and noise between frames (runs    *
+*   of `0xEF`/`0x7E`, garbage). Reports mis-decodes, throughput and resync cost.        *
+*                                                                                       *
+*   Build & run:  pio run -e native_fuzz && .pio/build/native_fuzz/program [seed] [n]   *
+*   (built with ASan/UBSan: any memory error aborts the run with a report)              *
+*                                                                                       *
+*****************************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include <random>
+#include <vector>
+#include "Commands.h"
+#include "Frame.h"
+#include "Parser.h"
+
+
+// A frame the stream is known to contain intact, and where it ends
+struct Expected {
+    dfplayer::Response response;
+    size_t             end;          // Offset just past its last byte
+    bool               after_fault;  // First intact frame after a fault
+    size_t             fault_start;  // Where that fault started
+};
+
+// A frame the parser decoded, and after which byte
+struct Decoded {
+    dfplayer::Response response;
+    size_t             end;
+};
+
+// Faults up to `TRUNCATE` damage a frame of the stream; the others add noise between frames
+enum class Fault : uint8_t {
+    DROP_BYTE,
+    BIT_FLIP,
+    BAD_FRAMING,
+    SPLICE,
+    TRUNCATE,
+    RUN_OF_END,
+    RUN_OF_HEAD,
+    GARBAGE,
+    COUNT
+};
+
+static const char* const FAULT_NAMES[] = {
+    "dropped byte", "bit flip", "bad framing", "spliced noise", "truncated frame",
+    "run of 0xEF", "run of 0x7E", "garbage"
+};
+
+// Codes the player actually sends
+static const uint8_t RESPONSE_CODES[] = {
+    dfplayer::cmd::QU_DEV_INSERTED, dfplayer::cmd::QU_DEV_UNPLUGGED, dfplayer::cmd::QU_TF_SD_COMPL,
+    dfplayer::cmd::SEND_INIT_PARAMS, dfplayer::cmd::ERROR_RESEND, dfplayer::cmd::RESPONSE,
+    dfplayer::cmd::QRY_STATUS, dfplayer::cmd::QRY_VOLUME, dfplayer::cmd::QRY_EQUALIZATION,
+    dfplayer::cmd::QRY_TOTAL_FILES_TFC, dfplayer::cmd::QRY_TRACK_SD_CARD,
+    dfplayer::cmd::QUERY_FLDR_TRACKS, dfplayer::cmd::QUERY_FLDR_COUNT
+};
+
+
+
+/**
+ * Builds a random stream of back-to-back frames, with a fault at roughly a quarter of them:
+ * either the frame itself is damaged (and not expected back), or noise goes in before it.
+ * A fault is always followed by an intact frame. A truncated frame runs straight into the
+ * next one, i.e. concatenation.
+ **/
+class StreamBuilder {
+public:
+    explicit StreamBuilder(uint32_t seed) : _rng(seed) {}
+
+    std::vector<uint8_t>  bytes;
+    std::vector<Expected> expected;
+    uint32_t              faults[static_cast<size_t>(Fault::COUNT)] = {};
+
+    void build(size_t frames)
+    {
+        bool   faulted     = false;   // A fault since the last intact frame
+        size_t fault_start = 0;
+
+        for (size_t i = 0; i < frames; i++) {
+            const dfplayer::frame::Frame frame = _random_frame();
+
+            // Never two damaged frames in a row: their pieces could join into a valid frame
+            if (!faulted && _chance(25)) {
+                const Fault fault = static_cast<Fault>(_rng() % static_cast<unsigned>(Fault::COUNT));
+                faults[static_cast<size_t>(fault)]++;
+                faulted     = true;
+                fault_start = bytes.size();
+                if (fault <= Fault::TRUNCATE) {
+                    _damage(frame, fault);
+                    continue;
+                }
+                _noise(fault);
+            }
+
+            bytes.insert(bytes.end(), frame.bytes, frame.bytes + dfplayer::frame::SIZE);
+            expected.push_back({ { frame.bytes[3], static_cast<uint16_t>((frame.bytes[5] << 8) | frame.bytes[6]) },
+                                 bytes.size(), faulted, fault_start });
+            faulted = false;
+        }
+    }
+
+private:
+    std::mt19937 _rng;
+
+    bool _chance(unsigned percent) { return _rng() % 100 < percent; }
+
+    dfplayer::frame::Frame _random_frame()
+    {
+        const uint8_t code = RESPONSE_CODES[_rng() % sizeof(RESPONSE_CODES)];
+        // Data bytes deliberately hit the special values (event codes, HEAD, END) often
+        static const uint8_t tricky[] = { 0x3A, 0x3D, 0x3F, 0x7E, 0xEF, 0xFF, 0x06, 0x00 };
+        const uint8_t d1 = _chance(30) ? tricky[_rng() % sizeof(tricky)] : static_cast<uint8_t>(_rng());
+        const uint8_t d2 = _chance(30) ? tricky[_rng() % sizeof(tricky)] : static_cast<uint8_t>(_rng());
+        return dfplayer::frame::make(code, d1, d2, _chance(50) ? dfplayer::frame::ACK : dfplayer::frame::NO_ACK);
+    }
+
+    /**
+     * Appends a damaged copy of `frame` in its place in the stream.
+     **/
+    void _damage(dfplayer::frame::Frame frame, Fault fault)
+    {
+        size_t len = dfplayer::frame::SIZE;
+
+        switch (fault)
+        {
+            case Fault::DROP_BYTE: {
+                const size_t at = _rng() % len;
+                for (size_t i = at; i + 1 < len; i++) frame.bytes[i] = frame.bytes[i + 1];
+                len--;
+                break;
+            }
+            case Fault::BIT_FLIP:
+                frame.bytes[_rng() % len] ^= static_cast<uint8_t>(1 << (_rng() % 8));
+                break;
+
+            case Fault::BAD_FRAMING: {
+                // Header, version, length or end byte replaced by another value
+                static const size_t framing[] = { 0, 1, 2, dfplayer::frame::SIZE - 1 };
+                frame.bytes[framing[_rng() % 4]] ^= static_cast<uint8_t>(1 + _rng() % 255);
+                break;
+            }
+            case Fault::SPLICE: {
+                // Noise in the middle of the frame, arriving while the parser is mid-frame. No
+                // `0x7E`/`0xEF`, and not the byte due there: otherwise the frame may still be
+                // decoded intact (realigned on a repeated HEAD, or ended early on a real END)
+                const size_t at = 1 + _rng() % (len - 1);
+                bytes.insert(bytes.end(), frame.bytes, frame.bytes + at);
+                const size_t count = 1 + _rng() % 8;
+                for (size_t i = 0; i < count; i++) {
+                    uint8_t noise;
+                    do {
+                        noise = static_cast<uint8_t>(_rng());
+                    } while (noise == dfplayer::frame::HEAD || noise == dfplayer::frame::END || (i == 0 && noise == frame.bytes[at]));
+                    bytes.push_back(noise);
+                }
+                bytes.insert(bytes.end(), frame.bytes + at, frame.bytes + len);
+                return;
+            }
+            case Fault::TRUNCATE:
+                len = 1 + _rng() % (len - 1);
+                break;
+
+            default:
+                return;
+        }
+
+        bytes.insert(bytes.end(), frame.bytes, frame.bytes + len);
+    }
+
+    /**
+     * Appends noise between frames.
+     **/
+    void _noise(Fault fault)
+    {
+        switch (fault)
+        {
+            case Fault::RUN_OF_END:
+            case Fault::RUN_OF_HEAD: {
+                const uint8_t value = fault == Fault::RUN_OF_END ? dfplayer::frame::END : dfplayer::frame::HEAD;
+                bytes.insert(bytes.end(), 1 + _rng() % 24, value);
+                break;
+            }
+            case Fault::GARBAGE: {
+                const size_t count = 1 + _rng() % 32;
+                for (size_t i = 0; i < count; i++) bytes.push_back(static_cast<uint8_t>(_rng()));
+                break;
+            }
+            default:
+                break;
+        }
+    }
+};
+
+
+
+/**
+ * Feeds a stream to a fresh parser, draining its ring every `drain_every` bytes.
+ **/
+static std::vector<Decoded> decode(const std::vector<uint8_t>& bytes, size_t drain_every, dfplayer::Parser& parser)
+{
+    std::vector<Decoded> decoded;
+    dfplayer::Response response;
+
+    for (size_t i = 0; i < bytes.size(); i++) {
+        parser.feed(bytes[i]);
+
+        if (static_cast<uint8_t>(parser.state()) >= dfplayer::frame::SIZE) {
+            fprintf(stderr, "FAIL: parser state out of range at byte %zu\n", i);
+            exit(1);
+        }
+        if ((i + 1) % drain_every == 0) {
+            while (parser.pop(response)) {
+                decoded.push_back({ response, i + 1 });
+            }
+        }
+    }
+    while (parser.pop(response)) {
+        decoded.push_back({ response, bytes.size() });
+    }
+    return decoded;
+}
+
+
+
+int main(int argc, char** argv)
+{
+    const uint32_t seed   = argc > 1 ? static_cast<uint32_t>(strtoul(argv[1], nullptr, 0)) : 1;
+    const size_t   frames = argc > 2 ? static_cast<size_t>(strtoul(argv[2], nullptr, 0)) : 200000;
+
+    StreamBuilder stream(seed);
+    stream.build(frames);
+
+    // 1) Correctness: drain after every byte so every decode can be matched to its offset
+    dfplayer::Parser parser;
+    const std::vector<Decoded> decoded = decode(stream.bytes, 1, parser);
+
+    size_t   next        = 0;
+    uint32_t correct     = 0;
+    uint32_t missed      = 0;
+    uint32_t mis_decoded = 0;
+    uint64_t resync_sum  = 0;
+    size_t   resync_max  = 0;
+    uint32_t resyncs     = 0;
+    bool     recovering  = false;   // A fault was injected and no good frame decoded since
+    size_t   fault_start = 0;       // Start of the first fault not recovered from yet
+
+    for (const Expected& want : stream.expected) {
+        if (want.after_fault && !recovering) {
+            recovering  = true;
+            fault_start = want.fault_start;
+        }
+
+        // Anything decoded before this frame's end that is not this frame is a mis-decode
+        while (next < decoded.size() && decoded[next].end < want.end) {
+            mis_decoded++;
+            next++;
+        }
+
+        const bool found = next < decoded.size() && decoded[next].end == want.end
+                        && decoded[next].response.cmd == want.response.cmd
+                        && decoded[next].response.param == want.response.param;
+        if (found) {
+            correct++;
+            next++;
+            if (recovering) {
+                // Fault start to the end of the first good decode (frames swallowed while realigning count)
+                const size_t cost = want.end - fault_start;
+                recovering  = false;
+                resync_sum += cost;
+                resync_max  = cost > resync_max ? cost : resync_max;
+                resyncs++;
+            }
+        } else {
+            missed++;
+        }
+    }
+    mis_decoded += static_cast<uint32_t>(decoded.size() - next);
+
+    // 2) Burst reads: let the ring fill up between drains, as a late `poll()` would
+    dfplayer::Parser burst_parser;
+    decode(stream.bytes, 64, burst_parser);
+
+    // 3) Throughput, clean and noisy
+    std::vector<uint8_t> clean;
+    for (const Expected& want : stream.expected) {
+        const dfplayer::frame::Frame frame = dfplayer::frame::make(want.response.cmd, want.response.param >> 8, want.response.param & 0xFF);
+        clean.insert(clean.end(), frame.bytes, frame.bytes + dfplayer::frame::SIZE);
+    }
+
+    auto throughput = [](const std::vector<uint8_t>& bytes) {
+        dfplayer::Parser timed;
+        dfplayer::Response response;
+        const auto start = std::chrono::steady_clock::now();
+        for (uint8_t b : bytes) {
+            if (timed.feed(b)) {
+                timed.pop(response);
+            }
+        }
+        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        return bytes.size() / seconds;
+    };
+    const double clean_bps = throughput(clean);
+    const double noisy_bps = throughput(stream.bytes);
+
+    printf("seed %u, %zu frames, %zu bytes\n\n", seed, frames, stream.bytes.size());
+    printf("faults injected:\n");
+    for (size_t i = 0; i < static_cast<size_t>(Fault::COUNT); i++) {
+        printf("  %-16s %8u\n", FAULT_NAMES[i], stream.faults[i]);
+    }
+    printf("\ndecoding:\n");
+    printf("  correct          %8u / %zu intact frames\n", correct, stream.expected.size());
+    printf("  missed           %8u   (intact frames swallowed while resyncing)\n", missed);
+    printf("  mis-decoded      %8u   (frames decoded that were never sent intact)\n", mis_decoded);
+    printf("  parser errors    %8u   bytes discarded %u\n", parser.errors(), parser.discarded());
+    printf("  ring overflows   %8u   (draining every 64 bytes)\n", burst_parser.overflows());
+    printf("\nresync after a fault (bytes from its start to the end of the next good frame):\n");
+    printf("  mean %.2f, max %zu over %u recoveries\n", resyncs ? double(resync_sum) / resyncs : 0.0, resync_max, resyncs);
+    printf("\nthroughput:\n");
+    printf("  clean stream     %8.1f MB/s\n", clean_bps / 1e6);
+    printf("  noisy stream     %8.1f MB/s\n", noisy_bps / 1e6);
+
+    return (missed == 0 && mis_decoded == 0) ? 0 : 1;
+}
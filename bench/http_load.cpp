@@ -0,0 +1,270 @@
+/****************************************************************************************
+*                                                                                       *
+*   http_load.cpp - HTTP load generator for the web app (runs on the host, POSIX)      *
+*                                                                                       *
+*   Written by Matt Kaufman, December, 2025.                                            *
+*                                                                                       *
+*   Simulates phones with the page open: each client polls `/log` every 2 s, `/state`   *
+*   every 3 s and `/status` every 5 s (as `index.html` does), plus a control tap every  *
+*   10 s, and reports requests per second and latency percentiles per endpoint.         *
+*                                                                                       *
+*   Build & run:  pio run -e native_http_load &&                                        *
+*                 .pio/build/native_http_load/program <host>[:port] [clients] [seconds] *
+*                                                                                       *
+*****************************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <netdb.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+
+
+using Clock = std::chrono::steady_clock;
+
+constexpr unsigned DEFAULT_CLIENTS = 4;      // Phones polling at once
+constexpr unsigned DEFAULT_SECONDS = 60;     // Length of the run
+constexpr unsigned TIMEOUT_S       = 5;      // A request not answered by then counts as failed
+
+
+// One endpoint a client polls, and how often
+struct Poll {
+    const char* path;
+    unsigned    every_ms;
+};
+
+constexpr Poll POLLS[] = {
+    { "/log",         2000 },
+    { "/state",       3000 },
+    { "/status",      5000 },
+    { "/volume_up",  10000 },
+};
+
+// Latencies of one endpoint, from all clients
+struct Samples {
+    std::vector<double> ms;
+    unsigned            failed = 0;
+};
+
+
+
+/**
+ * Opens a TCP connection to the device.
+ * @return The socket, `-1` on failure.
+ **/
+static int connect_to(const char* host, const char* port)
+{
+    addrinfo hints = {};
+    hints.ai_family   = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+
+    addrinfo* found = nullptr;
+    if (getaddrinfo(host, port, &hints, &found) != 0) {
+        return -1;
+    }
+
+    int fd = socket(found -> ai_family, found -> ai_socktype, found -> ai_protocol);
+    if (fd >= 0) {
+        timeval timeout = { TIMEOUT_S, 0 };
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+        if (connect(fd, found -> ai_addr, found -> ai_addrlen) != 0) {
+            close(fd);
+            fd = -1;
+        }
+    }
+    freeaddrinfo(found);
+    return fd;
+}
+
+
+
+/**
+ * Sends one `GET` and reads the whole response (headers, then `Content-Length` bytes,
+ * or up to the server closing the connection).
+ * @param fd The connection, reused if the server keeps it open; `-1` after it was closed.
+ * @return `true` if a complete response arrived.
+ **/
+static bool get(int& fd, const char* host, const char* port, const char* path)
+{
+    if (fd < 0) {
+        fd = connect_to(host, port);
+        if (fd < 0) {
+            return false;
+        }
+    }
+
+    char request[256];
+    const int len = snprintf(request, sizeof(request),
+        "GET %s HTTP/1.1\r\nHost: %s\r\nConnection: keep-alive\r\n\r\n", path, host);
+    if (send(fd, request, len, MSG_NOSIGNAL) != len) {
+        close(fd);
+        fd = -1;
+        return false;
+    }
+
+    std::string response;
+    size_t      body_start = std::string::npos;
+    long        body_len   = -1;
+    bool        keep_alive = true;
+    char        buf[1024];
+
+    for (;;) {
+        const ssize_t n = recv(fd, buf, sizeof(buf), 0);
+        if (n <= 0) {
+            close(fd);
+            fd = -1;
+            // Without `Content-Length`, the body ends when the server closes the connection
+            return n == 0 && body_start != std::string::npos && body_len < 0;
+        }
+        response.append(buf, n);
+
+        if (body_start == std::string::npos) {
+            body_start = response.find("\r\n\r\n");
+            if (body_start == std::string::npos) {
+                continue;
+            }
+            body_start += 4;
+
+            std::string head = response.substr(0, body_start);
+            std::transform(head.begin(), head.end(), head.begin(), ::tolower);
+            const size_t length = head.find("content-length:");
+            if (length != std::string::npos) {
+                body_len = strtol(head.c_str() + length + 15, nullptr, 10);
+            }
+            keep_alive = head.find("connection: close") == std::string::npos;
+        }
+
+        if (body_len >= 0 && response.size() >= body_start + body_len) {
+            break;
+        }
+    }
+
+    if (!keep_alive) {
+        close(fd);
+        fd = -1;
+    }
+    return true;
+}
+
+
+
+/**
+ * Runs one simulated phone until `end`.
+ **/
+static void client(const char* host, const char* port, unsigned index, Clock::time_point end,
+                   std::vector<Samples>& samples, std::mutex& mutex, unsigned& connections)
+{
+    const size_t count = sizeof(POLLS) / sizeof(POLLS[0]);
+    std::vector<Clock::time_point> next(count);
+
+    // Clients start out of step, as phones opened at different times
+    const Clock::time_point start = Clock::now() + std::chrono::milliseconds(index * 397 % 2000);
+    for (size_t i = 0; i < count; i++) {
+        next[i] = start + std::chrono::milliseconds(i * 131);
+    }
+
+    int      fd     = -1;
+    unsigned opened = 0;
+
+    while (Clock::now() < end) {
+        const size_t due = std::min_element(next.begin(), next.end()) - next.begin();
+        std::this_thread::sleep_until(next[due]);
+        next[due] += std::chrono::milliseconds(POLLS[due].every_ms);
+
+        opened += fd < 0 ? 1 : 0;
+        const Clock::time_point sent = Clock::now();
+        const bool ok = get(fd, host, port, POLLS[due].path);
+        const double ms = std::chrono::duration<double, std::milli>(Clock::now() - sent).count();
+
+        std::lock_guard<std::mutex> lock(mutex);
+        if (ok) {
+            samples[due].ms.push_back(ms);
+        } else {
+            samples[due].failed++;
+        }
+    }
+
+    if (fd >= 0) {
+        close(fd);
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    connections += opened;
+}
+
+
+
+/**
+ * Returns a percentile of sorted samples (nearest rank).
+ **/
+static double percentile(const std::vector<double>& sorted, double p)
+{
+    if (sorted.empty()) {
+        return 0;
+    }
+    size_t rank = static_cast<size_t>(p / 100.0 * sorted.size());
+    return sorted[std::min(rank, sorted.size() - 1)];
+}
+
+
+
+int main(int argc, char** argv)
+{
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s <host>[:port] [clients] [seconds]\n", argv[0]);
+        return 1;
+    }
+
+    // `host` or `host:port`
+    const std::string target  = argv[1];
+    const size_t      colon   = target.find(':');
+    const std::string host    = target.substr(0, colon);
+    const std::string port    = colon == std::string::npos ? "80" : target.substr(colon + 1);
+    const unsigned    clients = argc > 2 ? atoi(argv[2]) : DEFAULT_CLIENTS;
+    const unsigned    seconds = argc > 3 ? atoi(argv[3]) : DEFAULT_SECONDS;
+
+    std::vector<Samples> samples(sizeof(POLLS) / sizeof(POLLS[0]));
+    std::mutex           mutex;
+    unsigned             connections = 0;
+
+    printf("%u clients polling %s for %u s...\n", clients, target.c_str(), seconds);
+
+    const Clock::time_point end = Clock::now() + std::chrono::seconds(seconds);
+    std::vector<std::thread> threads;
+    for (unsigned i = 0; i < clients; i++) {
+        threads.emplace_back(client, host.c_str(), port.c_str(), i, end, std::ref(samples), std::ref(mutex), std::ref(connections));
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+
+    printf("%-14s %8s %7s %8s %8s %8s %8s\n", "endpoint", "requests", "failed", "p50 ms", "p90 ms", "p99 ms", "max ms");
+
+    std::vector<double> all;
+    unsigned            failed = 0;
+    for (size_t i = 0; i < samples.size(); i++) {
+        std::vector<double>& ms = samples[i].ms;
+        std::sort(ms.begin(), ms.end());
+        printf("%-14s %8zu %7u %8.1f %8.1f %8.1f %8.1f\n", POLLS[i].path, ms.size(), samples[i].failed,
+               percentile(ms, 50), percentile(ms, 90), percentile(ms, 99), ms.empty() ? 0 : ms.back());
+        all.insert(all.end(), ms.begin(), ms.end());
+        failed += samples[i].failed;
+    }
+
+    std::sort(all.begin(), all.end());
+    printf("%-14s %8zu %7u %8.1f %8.1f %8.1f %8.1f\n", "all", all.size(), failed,
+           percentile(all, 50), percentile(all, 90), percentile(all, 99), all.empty() ? 0 : all.back());
+    printf("\n%.1f requests/s, %u TCP connections (%.2f requests per connection)\n",
+           all.size() / static_cast<double>(seconds), connections,
+           connections ? all.size() / static_cast<double>(connections) : 0.0);
+
+    return failed == 0 ? 0 : 2;
+}
@@ -0,0 +1,557 @@
+/****************************************************************************************
+*                                                                                       *
+*   latency.cpp - Command-to-effect latency benchmark against the TD5580A simulator     *
+*                                                                                       *
+*   Written by Matt Kaufman, December, 2025.                                            *
+*                                                                                       *
+*   Runs scripted command sequences through `dfplayer::Driver` and reports how long     *
+*   each command takes to change the simulated chip, per link configuration.            *
+*                                                                                       *
+*   Build & run:  pio run -e native_bench && .pio/build/native_bench/program            *
+*                                                                                       *
+*****************************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <functional>
+#include <vector>
+#include "Driver.h"
+#include "TD5580ASim.h"
+
+
+using Player = dfplayer::Driver<dfplayer::sim::SimTransport>;
+using Chip   = dfplayer::sim::TD5580ASim::Chip;
+
+constexpr unsigned      RUNS       = 200;    // Runs per scenario and configuration
+constexpr unsigned long BOOT_MS    = 3000;   // Uptime when the scenario starts (the firmware waits in `begin()`)
+constexpr unsigned long GIVE_UP_MS = 10000;  // A step not done by then counts as lost
+
+constexpr unsigned long HEALTH_INTERVAL_MS = 2000;   // Health monitor interval in the recovery runs
+constexpr unsigned      RECOVERY_RUNS      = 50;     // Runs per glitch length
+
+constexpr unsigned      CATALOG_RUNS       = 20;     // Runs per card layout and link
+
+constexpr unsigned      NOW_PLAYING_RUNS   = 20;     // 10-minute listening sessions per setting
+constexpr unsigned long SESSION_MS         = 600000; // Length of one session
+
+
+
+// One scripted command and the chip state that shows it took effect
+struct Step {
+    unsigned long                    at_ms;    // When the command is issued (from scenario start)
+    std::function<void(Player&)>     action;
+    std::function<bool(const Chip&)> effect;
+};
+
+// Whatever the scenario needs to script its steps
+struct Context {
+    bool replied = false;   // Set by query callbacks
+};
+
+struct Scenario {
+    const char* name;
+    std::function<std::vector<Step>(Context&)> script;
+};
+
+struct Config {
+    const char*   name;
+    unsigned long baud;
+    bool          ack_mode;
+    unsigned      error_pct;   // Frames the chip rejects with `0x40` (%)
+    bool          calibrated;  // Use gaps measured by `calibrate()` instead of the command table
+};
+
+// Gaps measured by `calibrate()`, per opcode (see `calibrate_gaps()`)
+using Gaps = std::vector<uint16_t>;
+
+constexpr uint8_t GAP_OPCODES = 0x50;
+
+
+
+/**
+ * Runs `calibrate()` on a fresh simulator, after setting the values it needs to know
+ * (volume, EQ, source; stopped, so that `SET_SOURCE` is measured too).
+ * @param config The link configuration.
+ * @param seed Seed of the simulator's timing jitter.
+ * @return The gap of every opcode afterwards.
+ **/
+static Gaps calibrate_gaps(const Config& config, uint32_t seed)
+{
+    dfplayer::sim::Timing timing;
+    timing.baud = config.baud;
+
+    dfplayer::sim::TD5580ASim sim(timing, seed);
+    sim.advance(BOOT_MS);
+
+    Player player{dfplayer::sim::SimTransport(sim)};
+    player.begin();
+
+    player.set_source(2);
+    player.set_volume(10);
+    player.set_EQ(0);
+    player.stop_all_playback();
+
+    bool done = false;
+    bool ok   = false;
+    bool started = false;
+
+    for (unsigned long t = 0; !done && t < 60000; t++) {
+        if (!started && player.is_idle()) {
+            started = player.calibrate([&done, &ok](bool result) { done = true; ok = result; });
+        }
+        player.poll();
+        sim.advance(1);
+    }
+
+    if (!ok) {
+        fprintf(stderr, "calibration failed (%s)\n", config.name);
+    }
+
+    Gaps gaps(GAP_OPCODES);
+    for (uint8_t op = 0; op < GAP_OPCODES; op++) {
+        gaps[op] = player.get_gap(op);
+    }
+    return gaps;
+}
+
+
+
+/**
+ * Runs one scenario once, on a fresh simulator and driver.
+ * @param config The link configuration.
+ * @param gaps Gaps to use if the configuration is calibrated.
+ * @param scenario The scripted steps.
+ * @param seed Seed of the simulator's timing jitter.
+ * @param latencies Receives the latency of every completed step (ms).
+ * @param dropped Incremented by the number of frames the chip lost while busy.
+ * @return The number of steps that never took effect.
+ **/
+static unsigned run_once(const Config& config, const Gaps& gaps, const Scenario& scenario, uint32_t seed,
+                         std::vector<unsigned long>& latencies, unsigned& dropped)
+{
+    dfplayer::sim::Timing timing;
+    timing.baud      = config.baud;
+    timing.error_pct = config.error_pct;
+
+    dfplayer::sim::TD5580ASim sim(timing, seed);
+    sim.chip().volume = 10;
+    sim.advance(BOOT_MS);
+
+    Player player{dfplayer::sim::SimTransport(sim)};
+    player.begin();
+    player.set_ack_mode(config.ack_mode);
+
+    if (config.calibrated) {
+        for (uint8_t op = 0; op < GAP_OPCODES; op++) {
+            player.set_gap(op, gaps[op]);
+        }
+    }
+
+    Context context;
+    const std::vector<Step> steps = scenario.script(context);
+
+    size_t issued = 0;
+    size_t done   = 0;
+    const unsigned long start = sim.now_ms();
+
+    while (done < steps.size()) {
+        const unsigned long t = sim.now_ms() - start;
+
+        while (issued < steps.size() && steps[issued].at_ms <= t) {
+            steps[issued++].action(player);
+        }
+
+        // Steps complete in order: a step counts from its own issue time
+        while (done < issued && steps[done].effect(sim.chip())) {
+            latencies.push_back(t - steps[done].at_ms);
+            done++;
+        }
+
+        if (t > GIVE_UP_MS) {
+            break;
+        }
+
+        player.poll();
+        sim.advance(1);
+    }
+
+    dropped += sim.counters().lost;
+    return static_cast<unsigned>(steps.size() - done);
+}
+
+
+
+/**
+ * Cuts the simulated chip's power once, with the health monitor running, and waits for the
+ * driver to bring the chip back to where it was (volume 12, looping track 5).
+ * @param off_ms How long the power is off.
+ * @param seed Seed of the simulator's timing jitter.
+ * @param outage_ms Receives the silence the driver measured (`HealthStats::last_outage_ms`, `0` if no probe
+ *                  was missed: a short glitch only shows as a restart).
+ * @return Time from the power coming back to the state being restored (ms), `0` if it never was.
+ **/
+static unsigned long recover_once(unsigned long off_ms, uint32_t seed, unsigned long& outage_ms)
+{
+    using namespace dfplayer;
+    static constexpr dfplayer::Step init_sequence[] = {
+        step<op::SetSource>(arg<2>),
+        step<op::SetVolume>(arg<30>),
+        step<op::PowerOnVolume>(arg<30>),
+        step<op::LoopTrack>(arg<1>),
+    };
+
+    sim::Timing timing;
+    timing.jitter_pct = 10;
+
+    sim::TD5580ASim sim(timing, seed);
+    sim.advance(BOOT_MS);
+
+    Player player{sim::SimTransport(sim)};
+    player.begin();
+    player.set_ack_mode(true);
+    player.run_batch(init_sequence, sizeof(init_sequence) / sizeof(init_sequence[0]));
+    player.set_volume(12);
+    player.loop_track(5);
+    player.monitor(HEALTH_INTERVAL_MS, init_sequence, sizeof(init_sequence) / sizeof(init_sequence[0]));
+
+    // Settle, then glitch at a random point of the probe interval
+    const unsigned long glitch_ms = sim.now_ms() + 3000 + seed * 7919 % HEALTH_INTERVAL_MS;
+    const unsigned long back_ms   = glitch_ms + off_ms;
+    bool          glitched  = false;
+    unsigned long recovered = 0;
+
+    for (unsigned long t = 0; t < 60000; t++) {
+        if (!glitched && sim.now_ms() >= glitch_ms) {
+            sim.power_glitch(off_ms);
+            glitched = true;
+        }
+
+        const Chip& chip = sim.chip();
+        if (recovered == 0 && glitched && sim.now_ms() > back_ms && !chip.booting &&
+            chip.volume == 12 && chip.track == 5 && chip.looping && chip.status == 1) {
+            recovered = sim.now_ms() - back_ms;
+        }
+
+        // The outage is known once the monitor has seen the player answer again
+        if (recovered != 0 && player.get_health().health == dfplayer::Health::OK) {
+            outage_ms = player.get_health().last_outage_ms;
+            return recovered;
+        }
+
+        player.poll();
+        sim.advance(1);
+    }
+    return 0;
+}
+
+
+
+/**
+ * Indexes a simulated card three ways: one query at a time (as the old `get_folder_track_count()`
+ * loop did), with `scan_catalog()` on a new card, and with `scan_catalog()` on the same card again.
+ * @param baud The link rate.
+ * @param folders Folders on the card.
+ * @param seed Seed of the simulator's timing jitter.
+ * @param times Receives the three times (ms), `0` if that way failed.
+ **/
+static void catalog_once(unsigned long baud, uint16_t folders, uint32_t seed, unsigned long times[3])
+{
+    dfplayer::sim::Timing timing;
+    timing.baud       = baud;
+    timing.jitter_pct = 10;
+
+    dfplayer::sim::TD5580ASim sim(timing, seed);
+    sim.advance(BOOT_MS);
+    sim.chip().folder_count = folders;
+    sim.chip().total_tracks = folders * sim.chip().folder_tracks;
+
+    Player player{dfplayer::sim::SimTransport(sim)};
+    player.begin();
+    player.set_ack_mode(true);
+
+    auto run_until = [&](const std::function<bool()>& done) {
+        const unsigned long start = sim.now_ms();
+        for (unsigned long t = 0; t < 60000; t++) {
+            if (done()) {
+                return sim.now_ms() - start;
+            }
+            player.poll();
+            sim.advance(1);
+        }
+        return 0UL;
+    };
+
+    // One query at a time: each waits for the previous reply
+    unsigned pending = 2u + folders;
+    uint8_t  next    = 0;
+    bool     waiting = false;
+    times[0] = run_until([&]() {
+        if (!waiting && pending != 0) {
+            const uint8_t  command = next == 0 ? dfplayer::cmd::QRY_TOTAL_FILES_TFC
+                                   : next == 1 ? dfplayer::cmd::QUERY_FLDR_COUNT
+                                               : dfplayer::cmd::QUERY_FLDR_TRACKS;
+            const uint16_t param   = next < 2 ? 0 : next - 1;
+            waiting = player.query(command, param, [&](bool, uint16_t) { waiting = false; pending--; });
+            next += waiting ? 1 : 0;
+        }
+        return pending == 0;
+    });
+
+    for (unsigned long* time : { &times[1], &times[2] }) {
+        bool done = false;
+        bool ok   = false;
+        player.scan_catalog([&](bool result, bool) { done = true; ok = result; });
+        *time = run_until([&]() { return done; });
+        if (!ok) {
+            *time = 0;
+        }
+    }
+
+    if (player.get_catalog().folder_count != folders) {
+        times[1] = times[2] = 0;
+    }
+}
+
+
+
+/**
+ * Plays a 10-minute session (a track, shuffle, a few skips, 45 s tracks moving on by themselves)
+ * and measures how long the driver's current track differs from the chip's.
+ * @param min_ms Polling interval after a change (`0`: no `watch_track()`).
+ * @param max_ms Longest polling interval.
+ * @param seed Seed of the simulator's timing jitter (and shuffle order).
+ * @param polls Receives the number of `0x4C` polls sent.
+ * @return Time the driver reported the wrong track (ms).
+ **/
+static unsigned long now_playing_once(unsigned long min_ms, unsigned long max_ms, uint32_t seed, uint32_t& polls)
+{
+    dfplayer::sim::Timing timing;
+    timing.track_ms   = 45000;
+    timing.jitter_pct = 10;
+
+    dfplayer::sim::TD5580ASim sim(timing, seed);
+    sim.advance(BOOT_MS);
+
+    Player player{dfplayer::sim::SimTransport(sim)};
+    player.begin();
+    player.set_ack_mode(true);
+    if (min_ms != 0) {
+        player.watch_track(min_ms, max_ms);
+    }
+
+    const std::pair<unsigned long, std::function<void(Player&)>> script[] = {
+        { 0,      [](Player& p) { p.play_track(1); } },
+        { 5000,   [](Player& p) { p.shuffle_all_tracks(); } },
+        { 60000,  [](Player& p) { p.play_next(); } },
+        { 62000,  [](Player& p) { p.play_next(); } },
+        { 120000, [](Player& p) { p.play_previous(); } },
+    };
+
+    unsigned long wrong = 0;
+    size_t        next  = 0;
+
+    for (unsigned long t = 0; t < SESSION_MS; t++) {
+        if (next < sizeof(script) / sizeof(script[0]) && t == script[next].first) {
+            script[next].second(player);
+            next++;
+        }
+
+        if (sim.chip().status == 1 && player.get_currently_playing_track() != sim.chip().track) {
+            wrong++;
+        }
+
+        player.poll();
+        sim.advance(1);
+    }
+
+    polls = player.get_now_playing().polls;
+    return wrong;
+}
+
+
+
+/**
+ * Returns a percentile of sorted samples (nearest rank).
+ **/
+static unsigned long percentile(const std::vector<unsigned long>& sorted, double p)
+{
+    if (sorted.empty()) {
+        return 0;
+    }
+    size_t rank = static_cast<size_t>(p / 100.0 * sorted.size());
+    return sorted[std::min(rank, sorted.size() - 1)];
+}
+
+
+
+int main()
+{
+    const Config configs[] = {
+        { "9600 gap",       9600,   false, 0,  false },
+        { "9600 gap cal",   9600,   false, 0,  true  },
+        { "9600 ack",       9600,   true,  0,  false },
+        { "115200 gap",     115200, false, 0,  false },
+        { "115200 gap cal", 115200, false, 0,  true  },
+        { "115200 ack",     115200, true,  0,  false },
+        { "9600 gap 10%e",  9600,   false, 10, false },
+        { "9600 ack 10%e",  9600,   true,  10, false },
+    };
+
+    // Measured once per link, as the firmware does (then kept in NVS)
+    Gaps profiles[sizeof(configs) / sizeof(configs[0])];
+    printf("calibrated gaps (ms):     %-14s %6s %6s %6s %6s %6s %6s\n",
+           "", "SETVOL", "SETEQ", "SOURCE", "PLAYN", "PAUSE", "QUERY");
+    for (size_t i = 0; i < sizeof(configs) / sizeof(configs[0]); i++) {
+        if (!configs[i].calibrated) {
+            continue;
+        }
+        profiles[i] = calibrate_gaps(configs[i], 1);
+        const Gaps& g = profiles[i];
+        printf("%-26s %-14s %6u %6u %6u %6u %6u %6u\n", "", configs[i].name,
+               g[dfplayer::cmd::SET_VOL], g[dfplayer::cmd::SET_EQ], g[dfplayer::cmd::SET_SOURCE],
+               g[dfplayer::cmd::PLAY_N], g[dfplayer::cmd::PAUSE], g[dfplayer::cmd::QRY_STATUS]);
+    }
+    printf("\n");
+
+    const Scenario scenarios[] = {
+        { "volume burst (5x vol+)", [](Context&) {
+            std::vector<Step> steps;
+            for (uint8_t i = 1; i <= 5; i++) {
+                steps.push_back({ 0, [](Player& p) { p.increment_volume(); },
+                                  [i](const Chip& c) { return c.volume >= 10 + i; } });
+            }
+            return steps;
+        }},
+        { "play/adjust/pause/resume", [](Context&) {
+            return std::vector<Step>{
+                { 0,   [](Player& p) { p.play_track(5); },  [](const Chip& c) { return c.track == 5 && c.status == 1; } },
+                { 0,   [](Player& p) { p.set_volume(20); }, [](const Chip& c) { return c.volume == 20; } },
+                { 0,   [](Player& p) { p.set_EQ(3); },      [](const Chip& c) { return c.eq == 3; } },
+                { 300, [](Player& p) { p.pause(); },        [](const Chip& c) { return c.status == 2; } },
+                { 600, [](Player& p) { p.play(); },         [](const Chip& c) { return c.status == 1; } },
+            };
+        }},
+        { "track skipping (3x next)", [](Context&) {
+            return std::vector<Step>{
+                { 0,   [](Player& p) { p.play_track(1); }, [](const Chip& c) { return c.track == 1 && c.status == 1; } },
+                { 100, [](Player& p) { p.play_next(); },   [](const Chip& c) { return c.track == 2; } },
+                { 200, [](Player& p) { p.play_next(); },   [](const Chip& c) { return c.track == 3; } },
+                { 300, [](Player& p) { p.play_next(); },   [](const Chip& c) { return c.track == 4; } },
+            };
+        }},
+        { "query round trip (0x43)", [](Context& context) {
+            return std::vector<Step>{
+                { 0, [&context](Player& p) {
+                        p.query(dfplayer::cmd::QRY_VOLUME, [&context](bool ok, uint16_t) { context.replied = ok; });
+                     },
+                     [&context](const Chip&) { return context.replied; } },
+            };
+        }},
+    };
+
+    printf("%-26s %-14s %6s %5s %7s %6s %6s %6s %6s %6s\n",
+           "scenario", "link", "steps", "lost", "dropped", "min", "p50", "p90", "p99", "max");
+
+    for (const Scenario& scenario : scenarios) {
+        for (size_t i = 0; i < sizeof(configs) / sizeof(configs[0]); i++) {
+            const Config& config = configs[i];
+            std::vector<unsigned long> latencies;
+            unsigned lost    = 0;
+            unsigned dropped = 0;
+
+            for (unsigned run = 0; run < RUNS; run++) {
+                lost += run_once(config, profiles[i], scenario, run + 1, latencies, dropped);
+            }
+
+            std::sort(latencies.begin(), latencies.end());
+            printf("%-26s %-14s %6zu %5u %7u %6lu %6lu %6lu %6lu %6lu\n",
+                   scenario.name, config.name, latencies.size() + lost, lost, dropped,
+                   latencies.empty() ? 0 : latencies.front(),
+                   percentile(latencies, 50), percentile(latencies, 90), percentile(latencies, 99),
+                   latencies.empty() ? 0 : latencies.back());
+        }
+    }
+
+    printf("\nrecovery after a power glitch (health monitor every %lu ms, ack mode, 9600)\n", HEALTH_INTERVAL_MS);
+    printf("time from power back to volume/track restored (incl. %lu ms boot), silence measured by the driver\n",
+           dfplayer::sim::Timing().reset_ms);
+    printf("%-26s %6s %6s %8s %8s %8s %12s\n", "power off", "runs", "failed", "min", "p50", "max", "outage p50");
+
+    for (unsigned long off_ms : { 100UL, 1000UL, 5000UL, 20000UL }) {
+        std::vector<unsigned long> recoveries;
+        std::vector<unsigned long> outages;
+        unsigned failed = 0;
+
+        for (unsigned run = 0; run < RECOVERY_RUNS; run++) {
+            unsigned long outage = 0;
+            const unsigned long recovery = recover_once(off_ms, run + 1, outage);
+            if (recovery == 0) {
+                failed++;
+                continue;
+            }
+            recoveries.push_back(recovery);
+            outages.push_back(outage);
+        }
+
+        std::sort(recoveries.begin(), recoveries.end());
+        std::sort(outages.begin(), outages.end());
+        char label[32];
+        snprintf(label, sizeof(label), "%lu ms", off_ms);
+        printf("%-26s %6u %6u %8lu %8lu %8lu %12lu\n", label, RECOVERY_RUNS, failed,
+               recoveries.empty() ? 0 : recoveries.front(), percentile(recoveries, 50),
+               recoveries.empty() ? 0 : recoveries.back(), percentile(outages, 50));
+    }
+
+    printf("\nnow playing over a 10-minute session (shuffle, skips, 45 s tracks; ack mode, 9600), p50 of %u runs\n",
+           NOW_PLAYING_RUNS);
+    printf("%-26s %14s %10s\n", "polling", "wrong track ms", "polls");
+
+    const std::pair<unsigned long, unsigned long> intervals[] = { { 0, 0 }, { 500, 30000 }, { 250, 60000 } };
+    for (const auto& interval : intervals) {
+        std::vector<unsigned long> wrong;
+        std::vector<unsigned long> polls;
+        for (unsigned run = 0; run < NOW_PLAYING_RUNS; run++) {
+            uint32_t count = 0;
+            wrong.push_back(now_playing_once(interval.first, interval.second, run + 1, count));
+            polls.push_back(count);
+        }
+        std::sort(wrong.begin(), wrong.end());
+        std::sort(polls.begin(), polls.end());
+
+        char label[32];
+        if (interval.first == 0) {
+            snprintf(label, sizeof(label), "none");
+        } else {
+            snprintf(label, sizeof(label), "%lu..%lu ms", interval.first, interval.second);
+        }
+        printf("%-26s %14lu %10lu\n", label, percentile(wrong, 50), percentile(polls, 50));
+    }
+
+    printf("\ncard catalog (ack mode), p50 of %u runs (ms)\n", CATALOG_RUNS);
+    printf("%-26s %-14s %10s %10s %10s\n", "folders", "link", "serial", "scan", "same card");
+
+    for (uint16_t folders : { 1, 10, 40, 99 }) {
+        for (unsigned long baud : { 9600UL, 115200UL }) {
+            std::vector<unsigned long> samples[3];
+            for (unsigned run = 0; run < CATALOG_RUNS; run++) {
+                unsigned long times[3];
+                catalog_once(baud, folders, run + 1, times);
+                for (int i = 0; i < 3; i++) {
+                    samples[i].push_back(times[i]);
+                }
+            }
+            for (std::vector<unsigned long>& sample : samples) {
+                std::sort(sample.begin(), sample.end());
+            }
+
+            char label[8], link[16];
+            snprintf(label, sizeof(label), "%u", folders);
+            snprintf(link, sizeof(link), "%lu", baud);
+            printf("%-26s %-14s %10lu %10lu %10lu\n", label, link,
+                   percentile(samples[0], 50), percentile(samples[1], 50), percentile(samples[2], 50));
+        }
+    }
+
+    return 0;
+}
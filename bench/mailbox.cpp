@@ -0,0 +1,194 @@
+/****************************************************************************************
+*                                                                                       *
+*   mailbox.cpp - Stress test and benchmark for `Mailbox` (runs on the host)            *
+*                                                                                       *
+*   Written by Matt Kaufman, December, 2025.                                            *
+*                                                                                       *
+*   Several producer threads push numbered records while one consumer pops them, and    *
+*   checks that none is lost, duplicated or reordered (per producer); then the same     *
+*   load through a `std::mutex` + `std::deque`, for comparison.                         *
+*                                                                                       *
+*   Build & run:  pio run -e native_mailbox &&                                          *
+*                 .pio/build/native_mailbox/program [producers] [records per producer]  *
+*                                                                                       *
+*****************************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "Mailbox.h"
+
+
+using Clock = std::chrono::steady_clock;
+
+constexpr unsigned DEFAULT_PRODUCERS = 4;
+constexpr unsigned DEFAULT_RECORDS   = 1000000;
+constexpr size_t   SIZE              = 32;       // As `PlayerTask::MAILBOX_SIZE`
+
+
+// Same shape as `PlayerTask::Command`
+struct Record {
+    uint32_t producer;
+    uint32_t sequence;
+};
+
+// What the consumer saw
+struct Result {
+    double   seconds  = 0;
+    unsigned errors   = 0;
+    uint64_t full     = 0;   // Pushes rejected (and retried)
+};
+
+
+
+/**
+ * Checks one popped record against the last one seen from its producer.
+ **/
+static void check(const Record& record, std::vector<uint32_t>& expected, unsigned& errors)
+{
+    if (record.producer >= expected.size() || record.sequence != expected[record.producer]) {
+        if (errors++ < 10) {
+            fprintf(stderr, "  producer %u: got #%u, expected #%u\n", record.producer, record.sequence,
+                    record.producer < expected.size() ? expected[record.producer] : 0);
+        }
+    }
+    if (record.producer < expected.size()) {
+        expected[record.producer] = record.sequence + 1;
+    }
+}
+
+
+
+/**
+ * Runs the load through a `Mailbox`.
+ **/
+static Result run_mailbox(unsigned producers, unsigned records)
+{
+    Mailbox<Record, SIZE> mailbox;
+    std::vector<uint64_t> full(producers);
+    std::vector<std::thread> threads;
+    Result result;
+
+    const Clock::time_point start = Clock::now();
+    for (unsigned p = 0; p < producers; p++) {
+        threads.emplace_back([&, p] {
+            for (uint32_t i = 0; i < records; i++) {
+                while (!mailbox.push({ p, i })) {
+                    full[p]++;
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+
+    std::vector<uint32_t> expected(producers, 0);
+    const uint64_t total = static_cast<uint64_t>(producers) * records;
+    Record record;
+    for (uint64_t received = 0; received < total; ) {
+        if (mailbox.pop(record)) {
+            check(record, expected, result.errors);
+            received++;
+        } else {
+            std::this_thread::yield();
+        }
+    }
+    result.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    if (mailbox.pop(record)) {
+        fprintf(stderr, "  record left over after the run\n");
+        result.errors++;
+    }
+    for (uint64_t f : full) {
+        result.full += f;
+    }
+    return result;
+}
+
+
+
+/**
+ * Runs the same load through a locked `std::deque` bounded to the same size.
+ **/
+static Result run_locked(unsigned producers, unsigned records)
+{
+    std::mutex mutex;
+    std::deque<Record> queue;
+    std::vector<uint64_t> full(producers);
+    std::vector<std::thread> threads;
+    Result result;
+
+    const Clock::time_point start = Clock::now();
+    for (unsigned p = 0; p < producers; p++) {
+        threads.emplace_back([&, p] {
+            for (uint32_t i = 0; i < records; ) {
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    if (queue.size() < SIZE) {
+                        queue.push_back({ p, i++ });
+                        continue;
+                    }
+                }
+                full[p]++;
+                std::this_thread::yield();
+            }
+        });
+    }
+
+    std::vector<uint32_t> expected(producers, 0);
+    const uint64_t total = static_cast<uint64_t>(producers) * records;
+    for (uint64_t received = 0; received < total; ) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            while (!queue.empty()) {
+                check(queue.front(), expected, result.errors);
+                queue.pop_front();
+                received++;
+            }
+        }
+        std::this_thread::yield();
+    }
+    result.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    for (uint64_t f : full) {
+        result.full += f;
+    }
+    return result;
+}
+
+
+
+static void report(const char* name, const Result& result, uint64_t total)
+{
+    printf("%-14s %10.2f %12.0f %12llu %7u\n", name, result.seconds * 1000.0, total / result.seconds,
+           static_cast<unsigned long long>(result.full), result.errors);
+}
+
+
+
+int main(int argc, char** argv)
+{
+    const unsigned producers = argc > 1 ? atoi(argv[1]) : DEFAULT_PRODUCERS;
+    const unsigned records   = argc > 2 ? atoi(argv[2]) : DEFAULT_RECORDS;
+    const uint64_t total     = static_cast<uint64_t>(producers) * records;
+
+    printf("%u producers x %u records, mailbox of %zu\n\n", producers, records, SIZE);
+    printf("%-14s %10s %12s %12s %7s\n", "queue", "ms", "records/s", "full (retry)", "errors");
+
+    const Result mailbox = run_mailbox(producers, records);
+    report("Mailbox", mailbox, total);
+
+    const Result locked = run_locked(producers, records);
+    report("mutex+deque", locked, total);
+
+    return mailbox.errors == 0 && locked.errors == 0 ? 0 : 2;
+}
@@ -0,0 +1,303 @@
+/****************************************************************************************
+*                                                                                       *
+*   tap_latency.cpp - Control tap latency, HTTP vs `/ws` (runs on the host, POSIX)      *
+*                                                                                       *
+*   Written by Matt Kaufman, December, 2025.                                            *
+*                                                                                       *
+*   Sends the same harmless command (EQ normal) as the page does: once per tap over a   *
+*   fresh HTTP connection (`/set_eq_normal`), then over one WebSocket (`/ws`, timed to  *
+*   the acknowledgement), and reports latency percentiles for both.                     *
+*                                                                                       *
+*   Build & run:  pio run -e native_tap_latency &&                                      *
+*                 .pio/build/native_tap_latency/program <host>[:port] [taps]            *
+*                                                                                       *
+*****************************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+#include <netdb.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+
+
+using Clock = std::chrono::steady_clock;
+
+constexpr unsigned DEFAULT_TAPS = 50;
+constexpr unsigned TIMEOUT_S    = 5;      // A tap not answered by then counts as failed
+constexpr unsigned PAUSE_MS     = 200;    // Between taps (a person tapping)
+
+
+
+/**
+ * Opens a TCP connection to the device.
+ * @return The socket, `-1` on failure.
+ **/
+static int connect_to(const char* host, const char* port)
+{
+    addrinfo hints = {};
+    hints.ai_family   = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+
+    addrinfo* found = nullptr;
+    if (getaddrinfo(host, port, &hints, &found) != 0) {
+        return -1;
+    }
+
+    int fd = socket(found -> ai_family, found -> ai_socktype, found -> ai_protocol);
+    if (fd >= 0) {
+        timeval timeout = { TIMEOUT_S, 0 };
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+        if (connect(fd, found -> ai_addr, found -> ai_addrlen) != 0) {
+            close(fd);
+            fd = -1;
+        }
+    }
+    freeaddrinfo(found);
+    return fd;
+}
+
+
+
+/**
+ * Sends `request` and reads until the end of the response headers.
+ * @return The headers (and whatever followed them), empty on failure.
+ **/
+static std::string exchange_headers(int fd, const std::string& request)
+{
+    if (send(fd, request.data(), request.size(), MSG_NOSIGNAL) != static_cast<ssize_t>(request.size())) {
+        return "";
+    }
+
+    std::string response;
+    char buf[512];
+    while (response.find("\r\n\r\n") == std::string::npos) {
+        const ssize_t n = recv(fd, buf, sizeof(buf), 0);
+        if (n <= 0) {
+            return "";
+        }
+        response.append(buf, n);
+    }
+    return response;
+}
+
+
+
+/**
+ * One tap over HTTP, as the page did: new connection, `GET`, response, close.
+ * @return `true` if the device answered `2xx`.
+ **/
+static bool tap_http(const char* host, const char* port)
+{
+    const int fd = connect_to(host, port);
+    if (fd < 0) {
+        return false;
+    }
+
+    const std::string response = exchange_headers(fd,
+        std::string("GET /set_eq_normal HTTP/1.1\r\nHost: ") + host + "\r\nConnection: close\r\n\r\n");
+    close(fd);
+    return response.compare(0, 10, "HTTP/1.1 2") == 0;
+}
+
+
+
+/**
+ * Opens the WebSocket (the key is fixed: the handshake is not checked beyond `101`).
+ * @return The socket, `-1` on failure.
+ **/
+static int open_ws(const char* host, const char* port)
+{
+    const int fd = connect_to(host, port);
+    if (fd < 0) {
+        return -1;
+    }
+
+    const std::string response = exchange_headers(fd,
+        std::string("GET /ws HTTP/1.1\r\nHost: ") + host + "\r\n"
+        "Upgrade: websocket\r\nConnection: Upgrade\r\n"
+        "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\nSec-WebSocket-Version: 13\r\n\r\n");
+    if (response.compare(0, 12, "HTTP/1.1 101") != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+
+
+/**
+ * Sends one masked text frame (client frames must be masked).
+ **/
+static bool ws_send(int fd, const std::string& text)
+{
+    const uint8_t mask[4] = { 0x12, 0x34, 0x56, 0x78 };
+
+    std::string frame;
+    frame += static_cast<char>(0x81);                      // FIN, text
+    frame += static_cast<char>(0x80 | text.size());        // Masked, length < 126
+    frame.append(reinterpret_cast<const char*>(mask), 4);
+    for (size_t i = 0; i < text.size(); i++) {
+        frame += static_cast<char>(text[i] ^ mask[i % 4]);
+    }
+    return send(fd, frame.data(), frame.size(), MSG_NOSIGNAL) == static_cast<ssize_t>(frame.size());
+}
+
+
+
+/**
+ * Reads one unmasked server frame.
+ * @return Its payload, empty on failure.
+ **/
+static std::string ws_receive(int fd)
+{
+    auto read_exact = [fd](void* out, size_t len) {
+        size_t got = 0;
+        while (got < len) {
+            const ssize_t n = recv(fd, static_cast<char*>(out) + got, len - got, 0);
+            if (n <= 0) {
+                return false;
+            }
+            got += n;
+        }
+        return true;
+    };
+
+    uint8_t head[2];
+    if (!read_exact(head, 2)) {
+        return "";
+    }
+    size_t len = head[1] & 0x7F;
+    if (len == 126) {
+        uint8_t ext[2];
+        if (!read_exact(ext, 2)) {
+            return "";
+        }
+        len = (ext[0] << 8) | ext[1];
+    } else if (len == 127) {
+        return "";
+    }
+
+    std::string payload(len, '\0');
+    if (len > 0 && !read_exact(&payload[0], len)) {
+        return "";
+    }
+    return payload;
+}
+
+
+
+/**
+ * One tap over the socket: send a command, wait for the acknowledgement carrying its id
+ * (state and health messages in between are skipped).
+ * @return `true` if the device acknowledged it with `ok`.
+ **/
+static bool tap_ws(int fd, unsigned id)
+{
+    char command[64];
+    snprintf(command, sizeof(command), "{\"id\":%u,\"op\":\"set_eq\",\"args\":[0]}", id);
+    if (!ws_send(fd, command)) {
+        return false;
+    }
+
+    char expected[24];
+    snprintf(expected, sizeof(expected), "{\"id\":%u,", id);
+    for (;;) {
+        const std::string message = ws_receive(fd);
+        if (message.empty()) {
+            return false;
+        }
+        if (message.compare(0, strlen(expected), expected) == 0) {
+            return message.find("\"ok\":true") != std::string::npos;
+        }
+    }
+}
+
+
+
+/**
+ * Returns a percentile of sorted samples (nearest rank).
+ **/
+static double percentile(const std::vector<double>& sorted, double p)
+{
+    if (sorted.empty()) {
+        return 0;
+    }
+    size_t rank = static_cast<size_t>(p / 100.0 * sorted.size());
+    return sorted[std::min(rank, sorted.size() - 1)];
+}
+
+
+
+static void report(const char* name, std::vector<double>& ms, unsigned failed)
+{
+    std::sort(ms.begin(), ms.end());
+    printf("%-10s %6zu %7u %8.1f %8.1f %8.1f %8.1f\n", name, ms.size(), failed,
+           percentile(ms, 50), percentile(ms, 90), percentile(ms, 99), ms.empty() ? 0 : ms.back());
+}
+
+
+
+int main(int argc, char** argv)
+{
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s <host>[:port] [taps]\n", argv[0]);
+        return 1;
+    }
+
+    // `host` or `host:port`
+    const std::string target = argv[1];
+    const size_t      colon  = target.find(':');
+    const std::string host   = target.substr(0, colon);
+    const std::string port   = colon == std::string::npos ? "80" : target.substr(colon + 1);
+    const unsigned    taps   = argc > 2 ? atoi(argv[2]) : DEFAULT_TAPS;
+
+    std::vector<double> http_ms, ws_ms;
+    unsigned http_failed = 0, ws_failed = 0;
+
+    printf("%u taps on %s over HTTP, then over /ws...\n", taps, target.c_str());
+
+    for (unsigned i = 0; i < taps; i++) {
+        const Clock::time_point sent = Clock::now();
+        const bool ok = tap_http(host.c_str(), port.c_str());
+        const double ms = std::chrono::duration<double, std::milli>(Clock::now() - sent).count();
+        if (ok) {
+            http_ms.push_back(ms);
+        } else {
+            http_failed++;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(PAUSE_MS));
+    }
+
+    const int fd = open_ws(host.c_str(), port.c_str());
+    if (fd < 0) {
+        fprintf(stderr, "could not open /ws\n");
+        ws_failed = taps;
+    } else {
+        for (unsigned i = 0; i < taps; i++) {
+            const Clock::time_point sent = Clock::now();
+            const bool ok = tap_ws(fd, i + 1);
+            const double ms = std::chrono::duration<double, std::milli>(Clock::now() - sent).count();
+            if (ok) {
+                ws_ms.push_back(ms);
+            } else {
+                ws_failed++;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(PAUSE_MS));
+        }
+        close(fd);
+    }
+
+    printf("%-10s %6s %7s %8s %8s %8s %8s\n", "channel", "taps", "failed", "p50 ms", "p90 ms", "p99 ms", "max ms");
+    report("http", http_ms, http_failed);
+    report("ws", ws_ms, ws_failed);
+
+    return http_failed == 0 && ws_failed == 0 ? 0 : 2;
+}
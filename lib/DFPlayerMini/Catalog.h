@@ -0,0 +1,52 @@
+/****************************************************************************************
+*                                                                                       *
+*   Catalog.h - Index of the SD card of TD5580A-based DFPlayer Mini clones              *
+*                                                                                       *
+*   Written by Matt Kaufman, December, 2025.                                            *
+*                                                                                       *
+*****************************************************************************************/
+
+#pragma once
+#include <stdint.h>
+
+
+namespace dfplayer
+{
+    constexpr uint8_t MAX_FOLDERS = 99;  // Numbered folders `01`..`99`
+
+
+    /**
+     * What is on the card: the number of tracks `play_track()` can reach, and the number of
+     * tracks in each numbered folder (see `Driver::scan_catalog()`).
+     * Plain data, so it can be stored in NVS as-is.
+     **/
+    struct Catalog {
+        uint32_t fingerprint                = 0;   // See `catalog_fingerprint()` (`0`: never scanned)
+        uint16_t total_tracks               = 0;
+        uint8_t  folder_count               = 0;
+        uint8_t  folder_tracks[MAX_FOLDERS] = {};  // Tracks in folder `01` at index `0`, and so on
+    };
+
+
+    /**
+     * Identifies a card by the counts the player reports with two quick queries (FNV-1a).
+     * A card with the same counts as the cached catalog is taken to be the same card.
+     * @param total_tracks The total track count (`0x48`).
+     * @param folder_count The folder count (`0x4F`).
+     * @return The fingerprint, never `0`.
+     **/
+    constexpr uint32_t catalog_fingerprint(uint16_t total_tracks, uint8_t folder_count)
+    {
+        const uint8_t bytes[] = {
+            static_cast<uint8_t>(total_tracks >> 8),
+            static_cast<uint8_t>(total_tracks & 0xFF),
+            folder_count
+        };
+
+        uint32_t hash = 2166136261u;
+        for (uint8_t b : bytes) {
+            hash = (hash ^ b) * 16777619u;
+        }
+        return hash != 0 ? hash : 1;
+    }
+}
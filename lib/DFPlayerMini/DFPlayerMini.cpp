@@ -13,27 +13,33 @@
 *****************************************************************************************/
 
 #include <Arduino.h>
+#include <Preferences.h>
 #include "Commands.h"
+#include "Frame.h"
 #include "DFPlayerMini.h"
 
 
-/**
- * Clamps an integer to the specified byte range.
- * @param value The integer value to clamp.
- * @param low The lower bound.
- * @param high The upper bound.
- * @return The clamped integer, with type `byte`.
- **/
-static byte clamp_u8(int value, int low, int high)
-{
-    if (value < low) {
-        value = low;
-    }
-    if (value > high) {
-        value = high;
-    }
-    return static_cast<byte>(value);
-}
+// UART rates (see `dfplayer::cmd::SET_BAUD_RATE`)
+constexpr unsigned long DEFAULT_BAUD   = 9600;
+constexpr unsigned long FAST_BAUD      = 115200;
+constexpr byte          FAST_BAUD_CODE = 4;
+
+// NVS storage for the negotiated rate, the calibrated gaps (only valid at the rate they were measured at)
+// and the catalog of the last card seen
+constexpr const char* NVS_NAMESPACE     = "dfplayer";
+constexpr const char* NVS_BAUD_KEY      = "baud";
+constexpr const char* NVS_GAPS_KEY      = "gaps";
+constexpr const char* NVS_GAPS_BAUD_KEY = "gaps_baud";
+constexpr const char* NVS_CATALOG_KEY   = "catalog";
+
+constexpr unsigned long PROBE_TIMEOUT_MS   = 250;    // Time to wait for a reply to a status probe
+constexpr unsigned long STARTUP_TIMEOUT_MS = 2500;   // Time for the player to boot after power-on
+constexpr unsigned long RESET_TIMEOUT_MS   = 3000;   // Time for the player to come back after a reset
+
+
+
+// Instantiate the protocol for the hardware UART (see `extern template` in DFPlayerMini.h)
+template class dfplayer::Driver<dfplayer::HardwareSerialTransport>;
 
 
 
@@ -45,810 +51,334 @@ static byte clamp_u8(int value, int low, int high)
 DFPlayerMini::DFPlayerMini(
     int mcu_rx,
     int mcu_tx
-) : _mcu_rx(mcu_rx), _mcu_tx(mcu_tx) {}
+) : Driver(dfplayer::HardwareSerialTransport(Serial1)), _mcu_rx(mcu_rx), _mcu_tx(mcu_tx) {}
 
 
 
 /**
  * Initializes the MCU ⟷ DFPlayer Mini connection.
- * @param debug Show serial debug messages - default: `false`.
- **/
-void DFPlayerMini::begin(bool debug)
-{
-    _show_debug_messages = debug;
-
-    // Initialize serial connection
-    Serial1.begin(9600, SERIAL_8N1, _mcu_rx, _mcu_tx);
-    delay(2500);
-    _serial = &Serial1;
-    
-    if (_show_debug_messages) {
-        Serial.println("DFPlayerMini: Serial connection initialized.");
-    }
-}
-
-
-
-/**
- * [ `0x01` ]
- * 
- * Plays the next track.
- **/
-void DFPlayerMini::play_next()
-{
-    _send_command(dfplayer::cmd::NEXT);
-}
-
-
-
-/**
- * [ `0x02` ]
- * 
- * Plays the previous track.
- **/
-void DFPlayerMini::play_previous()
-{
-    _send_command(dfplayer::cmd::PREVIOUS);
-}
-
-
-
-/**
- * [ `0x03` ]
- * 
- * Plays a specific track.
- * @param track The track number to play.
- **/
-void DFPlayerMini::play_track(int track)
-{
-    _send_command(dfplayer::cmd::PLAY_N, clamp_u8(track, 1, 255));
-}
-
-
-
-/**
- * ```
- * 0x03
- * ```
- * 
- * Plays a specific track.
- * @param track The track number to play.
- **/
-void DFPlayerMini::play_track(byte track)
-{
-    _send_command(dfplayer::cmd::PLAY_N, track);
-}
-
-
-
-/**
- * ```
- * 0x0F
- * ```
- * 
- * Plays a specific track in a specific folder.
- * @param folder The folder number.
- * @param track The track number to play.
- **/
-void DFPlayerMini::play_track_in_folder(int folder, int track)
-{
-    _send_command(dfplayer::cmd::PLAY_F_FILE, clamp_u8(folder, 1, 99), clamp_u8(track, 1, 255));
-}
-
-
-
-/**
- * `0x0F`
- * 
- * Plays a specific track in a specific folder.
- * @param folder The folder number.
- * @param track The track number to play.
- **/
-void DFPlayerMini::play_track_in_folder(byte folder, byte track)
-{
-    _send_command(dfplayer::cmd::PLAY_F_FILE, folder, track);
-}
-
-
-
-/**
- * `0x08`
- * 
- * Loops a specific track indefinitely.
- * @param track The track number to loop.
- **/
-void DFPlayerMini::loop_track(int track)
-{
-    _send_command(dfplayer::cmd::PLAY_S_LOOP, clamp_u8(track, 1, 255));
-}
-
-
-
-/**
- * `0x08`
- * 
- * Loops a specific track indefinitely.
- * @param track The track number to loop.
- **/
-void DFPlayerMini::loop_track(byte track)
-{
-    _send_command(dfplayer::cmd::PLAY_S_LOOP, track);
-}
-
-
-
-/**
- * `0x08`
- * 
- * Loops a specific track in a specific folder indefinitely.
- * @param folder The folder number.
- * @param track The track number to loop.
- **/
-void DFPlayerMini::loop_track_in_folder(int folder, int track)
-{
-    _send_command(dfplayer::cmd::PLAY_S_LOOP, clamp_u8(folder, 1, 99), clamp_u8(track, 1, 255));
-}
-
-
-
-/**
- * `0x08`
- * 
- * Loops a specific track in a specific folder indefinitely.
- * @param folder The folder number.
- * @param track The track number to loop.
- **/
-void DFPlayerMini::loop_track_in_folder(byte folder, byte track)
-{
-    _send_command(dfplayer::cmd::PLAY_S_LOOP, folder, track);
-}
-
-
-
-/**
- * `0x17`
- * 
- * Loops all tracks in a specific folder indefinitely.
- * @param folder The folder number.
- **/
-void DFPlayerMini::loop_folder(int folder)
-{
-    _send_command(dfplayer::cmd::FOLDER_CYCLE, clamp_u8(folder, 1, 99), 0);
-}
-
-
-
-/**
- * `0x17`
- * 
- * Loops all tracks in a specific folder indefinitely.
- * @param folder The folder number.
- **/
-void DFPlayerMini::loop_folder(byte folder)
-{
-    _send_command(dfplayer::cmd::FOLDER_CYCLE, folder, 0);
-}
-
-
-
-/**
- * `0x11`
- * 
- * Loops all tracks indefinitely.
- **/
-void DFPlayerMini::loop_all_tracks()
-{
-    _send_command(dfplayer::cmd::PLAY_LOOPS);
-}
-
-
-
-/**
- * `0x18`
- * 
- * Plays all tracks in random order.
- **/
-void DFPlayerMini::shuffle_all_tracks()
-{
-    _send_command(dfplayer::cmd::PLAY_SHUFFLE);
-}
-
-
-
-/**
- * `0x19`
- * 
- * Starts looping the current track indefinitely.
- **/
-void DFPlayerMini::start_looping_current_track()
-{
-    _send_command(dfplayer::cmd::SET_SPLAY, 0, 1);
-}
-
-
-
-/**
- * `0x19`
- * 
- * Stops looping the current track.
- **/
-void DFPlayerMini::stop_looping_current_track()
-{
-    _send_command(dfplayer::cmd::SET_SPLAY, 0, 0);
-}
-
-
-
-/**
- * `0x12`
- * 
- * Specifies the MP3 folder.
- * @param folder The folder number.
- **/
-void DFPlayerMini::set_folder(int folder)
-{
-    _send_command(dfplayer::cmd::SET_FOLDER, clamp_u8(folder, 1, 99));
-}
-
-
-
-/**
- * `0x12`
- * 
- * Specifies the MP3 folder.
- * @param folder The folder number.
- **/
-void DFPlayerMini::set_folder(byte folder)
-{
-    _send_command(dfplayer::cmd::SET_FOLDER, folder);
-}
-
-
-
-/**
- * `0x09`
- * 
- * Specifies the playback source.
- * @param source The source to set (`1`: USB Disk, `2`: SD Card, `3`: Aux, `4`: Flash, `5`: PC, `6`: Sleep). 
- **/
-void DFPlayerMini::set_source(int source)
-{
-    _send_command(dfplayer::cmd::SET_SOURCE, clamp_u8(source, 1, 6));
-}
-
-
-
-/**
- * `0x09`
  * 
- * Specifies the playback source.
- * @param source The source to set (`1`: USB Disk, `2`: SD Card, `3`: Aux, `4`: Flash, `5`: PC, `6`: Sleep). 
+ * The link starts at the rate that worked last time (stored in NVS), falling back to 9600.
+ * The player is ready as soon as it sends its power-on `0x3F` frame or answers a status probe
+ * (right away after a warm MCU reset), after 2.5 s at most.
+ * With `fast_baud`, the player is then switched to 115200 (`0x1C` + reset) and the new rate is
+ * confirmed with a status query - if that fails, the link goes back to 9600.
+ * The catalog of the last card is loaded from NVS, and the card is scanned again whenever the
+ * player reports an inserted card (`0x3A`) - a scan that finds the same counts stops there.
+ * @param debug Show serial debug messages - default: `false`.
+ * @param fast_baud Negotiate 115200 baud with the player - default: `false`.
+ * @return `true` if the player answered (see `is_detected()`).
  **/
-void DFPlayerMini::set_source(byte source)
+bool DFPlayerMini::begin(bool debug, bool fast_baud)
 {
-    _send_command(dfplayer::cmd::SET_SOURCE, source);
-}
+    const unsigned long start_ms = millis();
 
+    Preferences prefs;
+    prefs.begin(NVS_NAMESPACE, true);
+    const unsigned long stored_baud = prefs.getULong(NVS_BAUD_KEY, DEFAULT_BAUD);
+    prefs.end();
 
+    // Initialize serial connection
+    _baud = stored_baud;
+    Serial1.begin(_baud, SERIAL_8N1, _mcu_rx, _mcu_tx);
+    Driver::begin(debug);
 
-/**
- * `0x04`
- * 
- * Increases the volume by one step.
- **/
-void DFPlayerMini::increment_volume()
-{
-    _send_command(dfplayer::cmd::VOL_UP);
-}
+    _detected = _await_ready(STARTUP_TIMEOUT_MS);
 
+    // A player that lost its rate (power cycle) boots at 9600
+    if (!_detected && _baud != DEFAULT_BAUD) {
+        _set_baud(DEFAULT_BAUD);
+        _detected = _probe(PROBE_TIMEOUT_MS);
+    }
 
+    if (_detected && fast_baud && _baud != FAST_BAUD) {
+        _negotiate_baud();
+    }
 
-/**
- * `0x05`
- * 
- * Decreases the volume by one step.
- **/
-void DFPlayerMini::decrement_volume()
-{
-    _send_command(dfplayer::cmd::VOL_DOWN);
-}
+    // Detection (and baud negotiation) time
+    const unsigned long ready_ms = millis() - start_ms;
 
+    if (_detected && _baud != stored_baud) {
+        prefs.begin(NVS_NAMESPACE, false);
+        prefs.putULong(NVS_BAUD_KEY, _baud);
+        prefs.end();
+    }
 
+    _load_gaps();
+    _load_catalog();
 
-/**
- * `0x06`
- * 
- * Sets the volume (range from 0-30).
- * @param volume The desired volume level.
- **/
-void DFPlayerMini::set_volume(int volume)
-{
-    _send_command(dfplayer::cmd::SET_VOL, clamp_u8(volume, 0, 30));
-}
-
+    on_event(dfplayer::cmd::QU_DEV_INSERTED, [this](const dfplayer::Response&) {
+        scan_catalog();
+    });
 
+    // From now on, bytes are parsed as they arrive (UART event task), not only when polled
+    Serial1.onReceive([this]() {
+        receive();
+        TaskHandle_t task = _receive_task.load(std::memory_order_acquire);
+        if (task != nullptr) {
+            xTaskNotifyGive(task);
+        }
+    });
+    _rx_event_driven = true;
+    
+    if (_show_debug_messages) {
+        if (_detected) {
+            Serial.printf("DFPlayerMini: Player ready after %lu ms (%lu baud).\n", ready_ms, _baud);
+        } else {
+            Serial.println("DFPlayerMini: Player not detected.");
+        }
+    }
 
-/**
- * `0x06`
- * 
- * Sets the volume (range from 0-30).
- * @param volume The desired volume level.
- **/
-void DFPlayerMini::set_volume(byte volume)
-{
-    _send_command(dfplayer::cmd::SET_VOL, volume);
+    return _detected;
 }
 
 
 
 /**
- * `0x1B`
- * 
- * Sets the power-on volume level (range from 0-30).
- * @param volume The desired volume level (`24` seems to be practical maximum).
+ * Checks whether the player answered during `begin()`.
+ * @return `true` if it sent a valid frame (power-on `0x3F` or a reply to a probe).
  **/
-void DFPlayerMini::set_power_on_volume(int volume)
+bool DFPlayerMini::is_detected() const
 {
-    _send_command(dfplayer::cmd::PWR_ON_VOL_MEM, clamp_u8(volume, 0, 30));
+    return _detected;
 }
 
 
 
 /**
- * `0x1B`
- * 
- * Sets the power-on volume level (range from 0-30).
- * @param volume The desired volume level (`24` seems to be practical maximum).
+ * Returns the UART rate the link settled on in `begin()`.
+ * @return The baud rate.
  **/
-void DFPlayerMini::set_power_on_volume(byte volume)
+unsigned long DFPlayerMini::get_baud_rate() const
 {
-    _send_command(dfplayer::cmd::PWR_ON_VOL_MEM, volume);
+    return _baud;
 }
 
 
 
 /**
- * `0x07`
- * 
- * Sets the equalization.
- * @param eq The desired EQ (`0`: Normal, `1`: Rock, `2`: ???, `3`: Pop, `4`: Classical, `5`: Country, `6`: Jazz).
+ * Measures the gap after each common command on this player (see `Driver::calibrate()`)
+ * and stores the profile in NVS, so it is used again after a restart.
+ * @param callback Called when the run ends (`ok == false` if some commands kept their table gap).
+ * @return `false` if not started or a run is already in progress.
  **/
-void DFPlayerMini::set_EQ(int eq)
+bool DFPlayerMini::calibrate(dfplayer::CalibrationCallback callback)
 {
-    _send_command(dfplayer::cmd::SET_EQ, clamp_u8(eq, 0, 6));
+    return Driver::calibrate([this, callback](bool ok) {
+        _save_gaps();
+        if (callback) {
+            callback(ok);
+        }
+    });
 }
 
 
 
 /**
- * `0x07`
- * 
- * Sets the equalization.
- * @param eq The desired EQ (`0`: Normal, `1`: Rock, `2`: ???, `3`: Pop, `4`: Classical, `5`: Country, `6`: Jazz).
+ * Indexes the card (see `Driver::scan_catalog()`) and stores the catalog in NVS when it changed,
+ * so it is available right after a restart.
+ * @param callback Called when the scan ends.
+ * @return `false` if not started or a scan is already running.
  **/
-void DFPlayerMini::set_EQ(byte eq)
+bool DFPlayerMini::scan_catalog(dfplayer::CatalogCallback callback)
 {
-    _send_command(dfplayer::cmd::SET_EQ, eq);
+    return Driver::scan_catalog([this, callback](bool ok, bool changed) {
+        if (ok && changed) {
+            _save_catalog();
+        }
+        if (callback) {
+            callback(ok, changed);
+        }
+    });
 }
 
 
 
 /**
- * `0x0D`
- * 
- * Plays/resumes playback.
+ * Wakes a task whenever bytes arrive from the player (after they are parsed), so that a task
+ * owning the player can sleep until `next_poll_in()` instead of polling on a tick.
+ * @param task The task to notify (`xTaskNotifyGive()`), `nullptr` for none.
  **/
-void DFPlayerMini::play()
+void DFPlayerMini::notify_on_receive(TaskHandle_t task)
 {
-    _send_command(dfplayer::cmd::PLAY);
+    _receive_task.store(task, std::memory_order_release);
 }
 
 
 
 /**
- * `0x0E`
- * 
- * Pauses playback.
+ * Switches the player to 115200 baud and confirms the new rate, falling back to 9600.
  **/
-void DFPlayerMini::pause()
+void DFPlayerMini::_negotiate_baud()
 {
-    _send_command(dfplayer::cmd::PAUSE);
-}
+    // The new rate takes effect after a restart
+    _transmit({ dfplayer::cmd::SET_BAUD_RATE, 0, FAST_BAUD_CODE });
+    delay(dfplayer::op::SetBaudRate::desc.gap_ms);
+    _transmit({ dfplayer::cmd::RESET, 0, 0 });
+    Serial1.flush();
 
+    _set_baud(FAST_BAUD);
+    if (_await_ready(RESET_TIMEOUT_MS)) {
+        return;
+    }
 
+    if (_show_debug_messages) {
+        Serial.println("DFPlayerMini: No reply at 115200 baud, falling back to 9600.");
+    }
 
-/**
- * `0x16`
- * 
- * Stops all playback actions.
- **/
-void DFPlayerMini::stop_all_playback()
-{
-    _send_command(dfplayer::cmd::STOP_PLAY);
-}
-
-
+    // Ask the player to go back to 9600 in case it did switch but garbles our frames
+    _transmit({ dfplayer::cmd::SET_BAUD_RATE, 0, 0 });
+    delay(dfplayer::op::SetBaudRate::desc.gap_ms);
+    _transmit({ dfplayer::cmd::RESET, 0, 0 });
+    Serial1.flush();
 
-/**
- * `0x0C`
- * 
- * Resets the player.
- **/
-void DFPlayerMini::reset()
-{
-    _send_command(dfplayer::cmd::RESET);
+    _set_baud(DEFAULT_BAUD);
+    _await_ready(RESET_TIMEOUT_MS);
 }
 
 
 
 /**
- * `0x1A`
- * 
- * Enables the DAC (disables DAC high impedance).
+ * Changes the MCU side of the link and drops anything received at the old rate.
+ * @param baud The new baud rate.
  **/
-void DFPlayerMini::enable_DAC()
+void DFPlayerMini::_set_baud(unsigned long baud)
 {
-    _send_command(dfplayer::cmd::DAC_IMP_HIGH, 0);
-}
-
-
+    _baud = baud;
+    Serial1.updateBaudRate(baud);
 
-/**
- * `0x1A`
- * 
- * Disables the DAC (enables DAC high impedance).
- **/
-void DFPlayerMini::disable_DAC()
-{
-    _send_command(dfplayer::cmd::DAC_IMP_HIGH, 1);
+    while (_transport.available() > 0) {
+        _transport.read();
+    }
+    _parser.reset();
 }
 
 
 
 /**
- * `0x0A`
- * 
- * Puts the player in low-power (sleep) mode.
+ * Sends a status query and waits for any valid frame (blocking, used during `begin()` only).
+ * @param timeout_ms Maximum time to wait.
+ * @return `true` if the player answered at the current rate.
  **/
-void DFPlayerMini::sleep()
+bool DFPlayerMini::_probe(unsigned long timeout_ms)
 {
-    _send_command(dfplayer::cmd::SLEEP_MODE);
+    _transmit({ dfplayer::cmd::QRY_STATUS, 0, 0 });
+    return _await_frame(timeout_ms);
 }
 
 
 
 /**
- * `0x0B`
- * 
- * Wakes the player from low-power (sleep) mode.
+ * Waits for the player to boot (power-on or reset): its `0x3F` frame, or a reply to a status probe.
+ * @param timeout_ms Maximum time to wait.
+ * @return `true` if the player is ready at the current rate.
  **/
-void DFPlayerMini::wakeup()
+bool DFPlayerMini::_await_ready(unsigned long timeout_ms)
 {
-    _send_command(dfplayer::cmd::WAKE_UP);
-}
-
-
+    const unsigned long start = millis();
 
-/**
- * `0x42`
- * 
- * Queries the player's current status.
- * @return The player's status as a `uint16_t`.
- **/
-uint16_t DFPlayerMini::get_status()
-{
-    _send_command(dfplayer::cmd::QRY_STATUS);
-    return _read_response();
+    while (millis() - start < timeout_ms) {
+        const unsigned long left = timeout_ms - (millis() - start);
+        if (_probe(left < PROBE_TIMEOUT_MS ? left : PROBE_TIMEOUT_MS)) {
+            return true;
+        }
+    }
+    return false;
 }
 
 
 
 /**
- * `0x43`
- * 
- * Queries the player's current volume.
- * @return The player's volume as a `uint16_t`.
+ * Waits for any valid frame from the player (blocking, used during `begin()` only).
+ * @param timeout_ms Maximum time to wait.
+ * @return `true` if a frame arrived in time.
  **/
-uint16_t DFPlayerMini::get_volume()
+bool DFPlayerMini::_await_frame(unsigned long timeout_ms)
 {
-    _send_command(dfplayer::cmd::QRY_VOLUME);
-    return _read_response();
-}
+    const unsigned long start = millis();
 
+    while (millis() - start < timeout_ms) {
+        receive();
 
+        dfplayer::Response response;
+        if (_parser.pop(response)) {
+            _handle_response(response);
+            while (_parser.pop(response)) {
+                _handle_response(response);
+            }
+            return true;
+        }
 
-/**
- * `0x4F`
- * 
- * Queries the number of folders on the storage device.
- * @return The number of folders as a `uint16_t`.
- **/
-uint16_t DFPlayerMini::get_folder_count()
-{
-    _send_command(dfplayer::cmd::QUERY_FLDR_COUNT);
-    return _read_response();
+        delay(1);
+    }
+    return false;
 }
 
 
 
 /**
- * `0x4E`
- * 
- * Queries the number of tracks in the current folder.
- * @return The number of tracks as a `uint16_t`.
+ * Restores the gaps measured by the last `calibrate()`, unless they were measured at another rate.
  **/
-uint16_t DFPlayerMini::get_folder_track_count()
+void DFPlayerMini::_load_gaps()
 {
-    _send_command(dfplayer::cmd::QUERY_FLDR_TRACKS);
-    return _read_response();
-}
-
+    Preferences prefs;
+    prefs.begin(NVS_NAMESPACE, true);
 
+    if (prefs.getULong(NVS_GAPS_BAUD_KEY, 0) == _baud &&
+        prefs.getBytesLength(NVS_GAPS_KEY) == sizeof(_gaps)) {
+        prefs.getBytes(NVS_GAPS_KEY, _gaps, sizeof(_gaps));
 
-/**
- * `0x48`
- * 
- * Queries the total number of tracks on the storage device.
- * @return The total number of tracks as a `uint16_t`.
- **/
-uint16_t DFPlayerMini::get_total_track_count()
-{
-    _send_command(dfplayer::cmd::QUERY_TOT_TRACKS);
-    return _read_response();
+        if (_show_debug_messages) {
+            Serial.println("DFPlayerMini: Using calibrated command gaps.");
+        }
+    }
+    prefs.end();
 }
 
 
 
 /**
- * Sends a one-byte command with no data (zero-fills both data bytes).
- * @param command The command byte.
+ * Stores the measured gaps, and the rate they were measured at.
  **/
-void DFPlayerMini::_send_command(byte command)
+void DFPlayerMini::_save_gaps()
 {
-    _send_command(command, 0, 0);
+    Preferences prefs;
+    prefs.begin(NVS_NAMESPACE, false);
+    prefs.putBytes(NVS_GAPS_KEY, _gaps, sizeof(_gaps));
+    prefs.putULong(NVS_GAPS_BAUD_KEY, _baud);
+    prefs.end();
 }
 
 
 
 /**
- * Sends a one-byte command with one byte of data (zero-fills the first data byte).
- * @param command The command byte.
- * @param data2 The second data byte.
+ * Restores the catalog of the last card seen (checked against the card by the next `scan_catalog()`).
  **/
-void DFPlayerMini::_send_command(byte command, byte data2)
+void DFPlayerMini::_load_catalog()
 {
-    _send_command(command, 0, data2);
-}
-
+    Preferences prefs;
+    prefs.begin(NVS_NAMESPACE, true);
 
+    if (prefs.getBytesLength(NVS_CATALOG_KEY) == sizeof(_catalog)) {
+        prefs.getBytes(NVS_CATALOG_KEY, &_catalog, sizeof(_catalog));
 
-/**
- * Sends a one-byte command with two bytes of data.
- * @param command The command byte.
- * @param data1 The first data byte.
- * @param data2 The second data byte.
- **/
-void DFPlayerMini::_send_command(byte command, byte data1, byte data2)
-{
-    if (_serial == nullptr) {
         if (_show_debug_messages) {
-            Serial.println("DFPlayerMini: _send_command called before begin()");
+            Serial.printf("DFPlayerMini: Cached catalog (%u tracks, %u folders).\n",
+                          _catalog.total_tracks, _catalog.folder_count);
         }
-        return;
-    }
-
-    byte send_buf[8] = {0};    // Initialize data bytes buffer
-    String send_str = "";      // Initialize string data buffer
-
-    // Command Structure HEAD ADDR LEN  CMD ACK DATA CKL CKH END
-    // Command Structure 0x7E 0xFF 0x06 CMD ACK DATA CK1 CK2 0xEF
-
-    delay(20);
-
-    send_buf[0] = 0x7E;     // HEAD byte constant
-    send_buf[1] = 0xFF;     // ADDR byte constant
-    send_buf[2] = 0x06;     // LEN  length excluding HEAD, END, CHECKSUM, and LENGTH bytes
-    send_buf[3] = command;  // CMD
-    send_buf[4] = 0x00;     // ACK  feedback 0x00 NO FEEDBACK, 0x01 FEEDBACK REQUESTED
-    send_buf[5] = data1;    // DATA data byte 1
-    send_buf[6] = data2;    // DATA data byyte 2
-    send_buf[7] = 0xEF;     // END  byte constant
-
-    for (int i = 0; i < 8; i++)
-    {
-        _serial -> write(send_buf[i]);
-        send_str += _sbyte2hex(send_buf[i]);
-    }
-
-    if (_show_debug_messages) {
-        Serial.print("Sending: ");
-        Serial.println(send_str);     // Display hex bytes sent to DFPlayer
     }
-
-    delay(500);
+    prefs.end();
 }
 
 
 
 /**
- * Reads and interprets the last frame received from the DFPlayer Mini.
- * @return The response as a `uint16_t`.
+ * Stores the catalog.
  **/
-uint16_t DFPlayerMini::_read_response()
+void DFPlayerMini::_save_catalog()
 {
-    uint16_t decoded_answer = 0x0000;       // Numeric value returned
-    String   answer         = _sanswer();   // Read from DFPlayer serial port
-    String   received       = "";           // Hex bytes received from DFPlayer
-
-    // Load different numeric values based on which call is being answered (indicated by byte 4, ansbuf[3]).
-    switch (_ansbuf[3])
-    {
-        /*
-        * 0x3A == Device insertion (SD / USB / Flash device)
-        * 0x3B == Device unplugged
-        * 0x3C == UDISK Playback Completed
-        * 0x3D == SD card playback completed
-        * 0x3E == Flash playback completed
-        * 0x3F == Send initialization parameters (set player status)
-        */
-        case 0x3A:
-            decoded_answer = 0x0001;
-            Serial.println ("\nMemory card inserted.");
-            break;
-
-        case 0x3B:
-            decoded_answer = 0x0002;
-            Serial.println("\nDevice unplugged.");
-            break;
-
-        case 0x3C:
-            decoded_answer = 0x0003;
-            Serial.println("\nDevice unplugged.");
-            break;
-
-        case 0x3D:
-            decoded_answer = 0x0004;
-            Serial.println("\nUDISK Playback Completed");
-            break;
-
-        case 0x3E:
-            decoded_answer = 0x0005;
-            Serial.println("\nFlash Playback Completed");
-            break;
-
-        case 0x3F:
-            decoded_answer = 0x0006;
-            Serial.println("\nSent initialization parameters");
-            break;
-
-        /*
-        * 0x40 == Return error, request resend
-        * 0x41 == Response
-        * 0x42 == Query current status
-        * 0x43 == Query the current volume
-        * 0x44 == Query the current EQ
-        * 0x45 == Query the current playback mode
-        */
-        case 0x40:
-            decoded_answer = 0x0007;
-            Serial.println("\nError, resend!");
-            break;
-
-        case 0x41:    
-            decoded_answer = 0x0008;
-            Serial.println("\nResponse received.");
-            break;
-
-        case 0x42:	     
-            switch(_ansbuf[6]) {
-                case 0: decoded_answer = 0x0A; break;  // |= (1<<4) | (1<<12); break;  // " -> Status: stopped"; break;
-                case 1: decoded_answer = 0x0B; break;  // |= (1<<4) | (1<<11); break;  // " -> Status: playing"; break;
-                case 2: decoded_answer = 0x0C; break;  // |= (1<<4) | (1<<10); break;  // " -> Status: paused"; break;
-            }
-            break;
-
-        case 0x43:
-            //+= " -> Vol playing: " + String(_ansbuf[6], DEC);
-            decoded_answer = _ansbuf[6];	  
-            break;
-
-        case 0x48:
-            //" -> File count: "
-            decoded_answer = _ansbuf[6];  
-            break;
-
-        case 0x4C:
-            //" -> Playing: "
-            decoded_answer = _ansbuf[6];
-            break;
-
-        case 0x4E:
-            //" -> Folder file count: "
-            decoded_answer = _ansbuf[6];  
-            break;
-
-        case 0x4F:
-            //" -> Folder count: "
-            decoded_answer = _ansbuf[6];	
-            break;
-    }
-
-    _ansbuf[3] = 0;  // Clear _ansbuf.
-    return decoded_answer;
+    Preferences prefs;
+    prefs.begin(NVS_NAMESPACE, false);
+    prefs.putBytes(NVS_CATALOG_KEY, &_catalog, sizeof(_catalog));
+    prefs.end();
 }
-
-
-
-/**
- * Converts a byte to a hexadecimal string representation.
- * @param b The byte to convert.
- * @return The hexadecimal string representation of the byte.
- **/
-String DFPlayerMini::_sbyte2hex(byte b)
-{
-    String shex;
-
-    shex = "0X";
-    if (b < 16) {
-        shex += "0";
-    }
-    shex += String(b, HEX);
-    shex += " ";
-    return shex;
-}
-
-
-
-/**
- * Reads the response from the DFPlayer Mini and returns it as a string.
- * @return The response string.
- **/
-String DFPlayerMini::_sanswer(void)
-{
-    byte b;
-    int iansidx = 0;
-    String answer = "";
-
-    while (_serial -> available()) {
-        b = _serial -> read();
-
-        /*
-         * 0x7E == Start byte
-         *   reset ansbuf index to zero
-         *   reset string response to null
-         */
-        if (b == 0x7E) {
-            iansidx = 0;
-            answer = "";
-        }
-
-        // Add each byte received to _ansbuf and also to the string response
-        _ansbuf[iansidx] = b;
-        answer += _sbyte2hex(_ansbuf[iansidx]);
-        iansidx++;
-
-        /*
-         *  0x3A .. 0x3F
-         *
-         * 0x3A == Device insertion (SD / USB / Flash device)
-         * 0x3B == Device unplugged
-         * 0x3C == UDISK Playback Completed
-         * 0x3D == SD card playback completed
-         * 0x3E == Flash playback completed
-         * 0x3F == Send initialization parameters (set player status)
-         */
-        if (b >= 0x3A && b <= 0x3F) {
-            _ansbuf[3] = b;
-        }
-
-        // 0xEF == End byte
-        if (b == 0xef) { }
-    }
-
-    // Debug - print output from DFPlayer device
-    if (_show_debug_messages) {
-        Serial.println("answer = " + String(answer));
-    }
-
-    return answer;
-}
\ No newline at end of file
@@ -16,94 +16,53 @@
 #define DF_PLAYER_MINI_H
 
 #include <Arduino.h>
+#include <atomic>
+#include "Driver.h"
+#include "Transport.h"
 
 
-class DFPlayerMini {
-public:
-    DFPlayerMini(int mcu_rx = D7, int mcu_tx = D6);
-
-    void begin(bool debug = false);
-
-    void play_next();
-    void play_previous();
-    
-    void play_track(int track);
-    void play_track(byte track);
-
-    void play_track_in_folder(int folder, int track);
-    void play_track_in_folder(byte folder, byte track);
-
-    void loop_track(int track);
-    void loop_track(byte track);
-
-    void loop_track_in_folder(int folder, int track);
-    void loop_track_in_folder(byte folder, byte track);
-
-    // void play_folder(int folder);   // void playF(byte f);
-    // void play_folder(byte folder);  // void playF(byte f);
-
-    void loop_folder(int folder);
-    void loop_folder(byte folder);
+// The protocol is compiled once, in DFPlayerMini.cpp
+extern template class dfplayer::Driver<dfplayer::HardwareSerialTransport>;
 
-    void loop_all_tracks();
 
-    void shuffle_all_tracks();
-
-    void start_looping_current_track();
-    void stop_looping_current_track();
-    
-    void set_folder(int folder);
-    void set_folder(byte folder);
-
-    void set_source(int source);
-    void set_source(byte source);
-
-    void increment_volume();
-    void decrement_volume();
-    void set_volume(int volume);
-    void set_volume(byte volume);
-    void set_power_on_volume(int volume);
-    void set_power_on_volume(byte volume);
-
-    void set_EQ(int eq);
-    void set_EQ(byte eq);
-
-    void play();
-    void pause();
-    void stop_all_playback();
-    
-    void reset();
+/**
+ * The driver on `Serial1`, with the ESP32-specific startup: baud negotiation, the calibrated
+ * timing profile and the card catalog (all remembered in NVS), and RX bytes parsed from the
+ * UART event task.
+ **/
+class DFPlayerMini : public dfplayer::Driver<dfplayer::HardwareSerialTransport> {
+public:
+    DFPlayerMini(int mcu_rx = D7, int mcu_tx = D6);
 
-    void enable_DAC();
-    void disable_DAC();
+    bool begin(bool debug = false, bool fast_baud = false);
+    bool is_detected() const;
+    unsigned long get_baud_rate() const;
 
-    void sleep();
-    void wakeup();
+    bool calibrate(dfplayer::CalibrationCallback callback = nullptr);
+    bool scan_catalog(dfplayer::CatalogCallback callback = nullptr);
 
-    uint16_t get_status();
-    uint16_t get_volume();
-    uint16_t get_folder_count();
-    uint16_t get_folder_track_count();
-    uint16_t get_total_track_count();
-    // uint16_t get_currently_playing_track(); // uint16_t qPlaying();
+    void notify_on_receive(TaskHandle_t task);
 
 private:
     int _mcu_rx;    // MCU RX pin
     int _mcu_tx;    // MCU TX pin
 
-    Stream* _serial = nullptr;      // Serial stream
-    byte    _ansbuf[15] = {0};      // Response buffer
-    bool    _show_debug_messages;   // Show debug flag
+    unsigned long _baud     = 9600;    // Current UART rate
+    bool          _detected = false;   // The player answered during `begin()`
+
+    std::atomic<TaskHandle_t> _receive_task{nullptr};  // Notified when bytes arrive (see `notify_on_receive()`)
 
-    String _sanswer();
-    String _sbyte2hex(byte b);
-    // int    _shex2int(char *s, int n);
+    void _negotiate_baud();
+    void _set_baud(unsigned long baud);
+    bool _probe(unsigned long timeout_ms);
+    bool _await_ready(unsigned long timeout_ms);
+    bool _await_frame(unsigned long timeout_ms);
 
-    uint16_t _read_response();
+    void _load_gaps();
+    void _save_gaps();
 
-    void _send_command(byte command);
-    void _send_command(byte command, byte data2);
-    void _send_command(byte command, byte data1, byte data2);
+    void _load_catalog();
+    void _save_catalog();
 };
 
 
@@ -0,0 +1,204 @@
+/****************************************************************************************
+*                                                                                       *
+*   Descriptors.h - Compile-time command table for TD5580A-based DFPlayer Mini clones   *
+*                                                                                       *
+*   Written by Matt Kaufman, December, 2025.                                            *
+*                                                                                       *
+*   See:                                                                                *
+*     1. http://www.tudasemi.com/static/upload/file/20240905/1725499313437991.pdf       *
+*                                                                                       *
+*****************************************************************************************/
+
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <type_traits>
+#include "Commands.h"
+
+
+namespace dfplayer
+{
+    // Valid values of one argument (inclusive)
+    struct Range {
+        uint16_t low;
+        uint16_t high;
+    };
+
+
+    /**
+     * Everything the driver needs to know about a command:
+     * - `arity`: `0`, `1` (sent in DATA1:DATA2, or in DATA1 alone if `arg_in_data1`), or `2` (DATA1, DATA2)
+     * - `args`: valid range of each argument
+     * - `expects_reply`: the player answers with a frame carrying the same command byte
+     * - `gap_ms`: minimum time before the next frame may be sent
+     **/
+    struct Descriptor {
+        uint8_t  opcode;
+        uint8_t  arity;
+        Range    args[2];
+        bool     arg_in_data1;
+        bool     expects_reply;
+        uint16_t gap_ms;
+    };
+
+
+    // One command of a `run_batch()` sequence (build with `step<op::...>()`)
+    struct Step {
+        uint8_t command;
+        uint8_t data1;
+        uint8_t data2;
+    };
+
+
+    // Compile-time argument: `arg<30>` is checked against the command's range by the compiler
+    template <int N>
+    using Arg = std::integral_constant<int, N>;
+
+    template <int N>
+    constexpr Arg<N> arg{};
+
+
+    /**
+     * The command table. Gaps are conservative: settings are ready quickly, anything that
+     * opens a file or restarts the player is not.
+     **/
+    namespace op
+    {
+        constexpr uint16_t QUICK_MS = 100;    // Settings, queries
+        constexpr uint16_t FILE_MS  = 500;    // Commands that (re)open a file
+        constexpr uint16_t BOOT_MS  = 1500;   // Commands that restart the player
+
+        constexpr Range NONE   = { 0, 0 };
+        constexpr Range TRACK  = { 1, 255 };
+        constexpr Range FOLDER = { 1, 99 };
+        constexpr Range VOLUME = { 0, 30 };
+        constexpr Range FLAG   = { 0, 1 };
+
+        //                                                          opcode               arity  args               data1  reply  gap
+        struct Next              { static constexpr Descriptor desc{ cmd::NEXT,             0, { NONE,   NONE },   false, false, FILE_MS  }; };
+        struct Previous          { static constexpr Descriptor desc{ cmd::PREVIOUS,         0, { NONE,   NONE },   false, false, FILE_MS  }; };
+        struct PlayTrack         { static constexpr Descriptor desc{ cmd::PLAY_N,           1, { TRACK,  NONE },   false, false, FILE_MS  }; };
+        struct VolumeUp          { static constexpr Descriptor desc{ cmd::VOL_UP,           0, { NONE,   NONE },   false, false, QUICK_MS }; };
+        struct VolumeDown        { static constexpr Descriptor desc{ cmd::VOL_DOWN,         0, { NONE,   NONE },   false, false, QUICK_MS }; };
+        struct SetVolume         { static constexpr Descriptor desc{ cmd::SET_VOL,          1, { VOLUME, NONE },   false, false, QUICK_MS }; };
+        struct SetEQ             { static constexpr Descriptor desc{ cmd::SET_EQ,           1, { {0, 6}, NONE },   false, false, QUICK_MS }; };
+        struct LoopTrack         { static constexpr Descriptor desc{ cmd::PLAY_S_LOOP,      1, { TRACK,  NONE },   false, false, FILE_MS  }; };
+        struct LoopTrackInFolder { static constexpr Descriptor desc{ cmd::PLAY_S_LOOP,      2, { FOLDER, TRACK },  false, false, FILE_MS  }; };
+        struct SetSource         { static constexpr Descriptor desc{ cmd::SET_SOURCE,       1, { {1, 6}, NONE },   false, false, FILE_MS  }; };
+        struct Sleep             { static constexpr Descriptor desc{ cmd::SLEEP_MODE,       0, { NONE,   NONE },   false, false, FILE_MS  }; };
+        struct WakeUp            { static constexpr Descriptor desc{ cmd::WAKE_UP,          0, { NONE,   NONE },   false, false, FILE_MS  }; };
+        struct Reset             { static constexpr Descriptor desc{ cmd::RESET,            0, { NONE,   NONE },   false, false, BOOT_MS  }; };
+        struct Play              { static constexpr Descriptor desc{ cmd::PLAY,             0, { NONE,   NONE },   false, false, QUICK_MS }; };
+        struct Pause             { static constexpr Descriptor desc{ cmd::PAUSE,            0, { NONE,   NONE },   false, false, QUICK_MS }; };
+        struct PlayTrackInFolder { static constexpr Descriptor desc{ cmd::PLAY_F_FILE,      2, { FOLDER, TRACK },  false, false, FILE_MS  }; };
+        struct LoopAll           { static constexpr Descriptor desc{ cmd::PLAY_LOOPS,       0, { NONE,   NONE },   false, false, FILE_MS  }; };
+        struct SetFolder         { static constexpr Descriptor desc{ cmd::SET_FOLDER,       1, { FOLDER, NONE },   false, false, QUICK_MS }; };
+        struct Stop              { static constexpr Descriptor desc{ cmd::STOP_PLAY,        0, { NONE,   NONE },   false, false, QUICK_MS }; };
+        struct LoopFolder        { static constexpr Descriptor desc{ cmd::FOLDER_CYCLE,     1, { FOLDER, NONE },   true,  false, FILE_MS  }; };
+        struct Shuffle           { static constexpr Descriptor desc{ cmd::PLAY_SHUFFLE,     0, { NONE,   NONE },   false, false, FILE_MS  }; };
+        struct LoopCurrent       { static constexpr Descriptor desc{ cmd::SET_SPLAY,        1, { FLAG,   NONE },   false, false, QUICK_MS }; };
+        struct DACHighImpedance  { static constexpr Descriptor desc{ cmd::DAC_IMP_HIGH,     1, { FLAG,   NONE },   false, false, QUICK_MS }; };
+        struct PowerOnVolume     { static constexpr Descriptor desc{ cmd::PWR_ON_VOL_MEM,   1, { VOLUME, NONE },   false, false, QUICK_MS }; };
+        struct SetBaudRate       { static constexpr Descriptor desc{ cmd::SET_BAUD_RATE,    1, { {0, 4}, NONE },   false, false, FILE_MS  }; };
+
+        struct QueryStatus       { static constexpr Descriptor desc{ cmd::QRY_STATUS,          0, { NONE, NONE }, false, true, QUICK_MS }; };
+        struct QueryVolume       { static constexpr Descriptor desc{ cmd::QRY_VOLUME,          0, { NONE, NONE }, false, true, QUICK_MS }; };
+        struct QueryEQ           { static constexpr Descriptor desc{ cmd::QRY_EQUALIZATION,    0, { NONE, NONE }, false, true, QUICK_MS }; };
+        struct QueryTrackCount   { static constexpr Descriptor desc{ cmd::QRY_TOTAL_FILES_TFC, 0, { NONE, NONE }, false, true, QUICK_MS }; };
+        struct QueryTrack        { static constexpr Descriptor desc{ cmd::QRY_TRACK_SD_CARD,   0, { NONE, NONE }, false, true, QUICK_MS }; };
+        struct QueryFolderTracks { static constexpr Descriptor desc{ cmd::QUERY_FLDR_TRACKS,   1, { FOLDER, NONE }, false, true, QUICK_MS }; };
+        struct QueryFolderCount  { static constexpr Descriptor desc{ cmd::QUERY_FLDR_COUNT,    0, { NONE, NONE }, false, true, QUICK_MS }; };
+
+        // Every command above, for lookups by opcode at runtime (first match wins)
+        constexpr Descriptor TABLE[] = {
+            Next::desc, Previous::desc, PlayTrack::desc, VolumeUp::desc, VolumeDown::desc, SetVolume::desc,
+            SetEQ::desc, LoopTrack::desc, LoopTrackInFolder::desc, SetSource::desc, Sleep::desc, WakeUp::desc,
+            Reset::desc, Play::desc, Pause::desc, PlayTrackInFolder::desc, LoopAll::desc, SetFolder::desc,
+            Stop::desc, LoopFolder::desc, Shuffle::desc, LoopCurrent::desc, DACHighImpedance::desc,
+            PowerOnVolume::desc, SetBaudRate::desc,
+            QueryStatus::desc, QueryVolume::desc, QueryEQ::desc, QueryTrackCount::desc, QueryTrack::desc,
+            QueryFolderTracks::desc, QueryFolderCount::desc
+        };
+    }
+
+
+    /**
+     * Looks up the descriptor of a command byte.
+     * @param opcode The command byte.
+     * @return The descriptor, or `nullptr` if the command is not in the table.
+     **/
+    constexpr const Descriptor* descriptor(uint8_t opcode)
+    {
+        for (const Descriptor& desc : op::TABLE) {
+            if (desc.opcode == opcode) {
+                return &desc;
+            }
+        }
+        return nullptr;
+    }
+
+    static_assert(descriptor(cmd::RESET)->gap_ms == op::BOOT_MS, "Command table lookup");
+
+
+    namespace detail
+    {
+        // Constant argument: rejected by the compiler if out of range, never clamped
+        template <typename Cmd, size_t I, int N>
+        constexpr uint16_t checked(std::integral_constant<int, N>)
+        {
+            static_assert(I < Cmd::desc.arity, "Too many arguments for this command");
+            static_assert(N >= Cmd::desc.args[I].low && N <= Cmd::desc.args[I].high, "Argument out of range for this command");
+            return static_cast<uint16_t>(N);
+        }
+
+        // Runtime argument: clamped to the command's range
+        template <typename Cmd, size_t I>
+        constexpr uint16_t checked(int value)
+        {
+            static_assert(I < Cmd::desc.arity, "Too many arguments for this command");
+            return value < Cmd::desc.args[I].low  ? Cmd::desc.args[I].low
+                 : value > Cmd::desc.args[I].high ? Cmd::desc.args[I].high
+                 : static_cast<uint16_t>(value);
+        }
+
+        template <typename Cmd>
+        constexpr Step encode(uint16_t first, uint16_t second)
+        {
+            switch (Cmd::desc.arity)
+            {
+                case 0:  return { Cmd::desc.opcode, 0, 0 };
+                case 1:  return Cmd::desc.arg_in_data1
+                              ? Step{ Cmd::desc.opcode, static_cast<uint8_t>(first), 0 }
+                              : Step{ Cmd::desc.opcode, static_cast<uint8_t>(first >> 8), static_cast<uint8_t>(first & 0xFF) };
+                default: return { Cmd::desc.opcode, static_cast<uint8_t>(first), static_cast<uint8_t>(second) };
+            }
+        }
+    }
+
+
+    /**
+     * Builds the frame data of a command from its descriptor. Arguments given as `arg<N>` are
+     * range-checked at compile time; plain integers are clamped to the valid range.
+     * e.g. `step<op::SetVolume>(arg<20>)`, `step<op::PlayTrack>(track)`
+     **/
+    template <typename Cmd>
+    constexpr Step step()
+    {
+        static_assert(Cmd::desc.arity == 0, "Missing arguments for this command");
+        return detail::encode<Cmd>(0, 0);
+    }
+
+    template <typename Cmd, typename A>
+    constexpr Step step(A first)
+    {
+        static_assert(Cmd::desc.arity == 1, "Wrong number of arguments for this command");
+        return detail::encode<Cmd>(detail::checked<Cmd, 0>(first), 0);
+    }
+
+    template <typename Cmd, typename A, typename B>
+    constexpr Step step(A first, B second)
+    {
+        static_assert(Cmd::desc.arity == 2, "Wrong number of arguments for this command");
+        return detail::encode<Cmd>(detail::checked<Cmd, 0>(first), detail::checked<Cmd, 1>(second));
+    }
+}
@@ -0,0 +1,2764 @@
+/****************************************************************************************
+*                                                                                       *
+*   Driver.h - Transport-independent driver for TD5580A-based DFPlayer Mini clones      *
+*                                                                                       *
+*   Written by Matt Kaufman, December, 2025.                                            *
+*                                                                                       *
+*   See:                                                                                *
+*     1. http://www.tudasemi.com/static/upload/file/20240905/1725499313437991.pdf       *
+*                                                                                       *
+*****************************************************************************************/
+
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <functional>
+#include "Catalog.h"
+#include "Commands.h"
+#include "Descriptors.h"
+#include "Frame.h"
+#include "Parser.h"
+#include "State.h"
+
+
+namespace dfplayer
+{
+    // Called from `poll()` with the query's reply (`ok == true`), or on timeout (`ok == false`, `value == 0`)
+    using QueryCallback = std::function<void(bool ok, uint16_t value)>;
+
+    // Called from `poll()` once every query of a `refresh()` has completed
+    using RefreshCallback = std::function<void(bool ok)>;
+
+    // Called from `poll()` for an unsolicited frame (`0x3A`..`0x3F`)
+    using EventCallback = std::function<void(const Response& event)>;
+
+    constexpr uint8_t ANY_EVENT = 0x00;  // Subscribe to every event (see `on_event()`)
+
+    // Called from `poll()` once a `run_batch()` sequence has been sent
+    using BatchCallback = std::function<void()>;
+
+    // Called from `poll()` when a `calibrate()` run ends (`ok == false` if a command kept its table gap)
+    using CalibrationCallback = std::function<void(bool ok)>;
+
+    // Called from `poll()` when a `scan_catalog()` ends (`changed`: the catalog was replaced by a new one)
+    using CatalogCallback = std::function<void(bool ok, bool changed)>;
+
+
+    // Delivery counters of one command (see `get_stats()`)
+    struct CommandStats {
+        uint32_t sent      = 0;  // Commands sent (first attempts only)
+        uint32_t succeeded = 0;  // Acknowledged/answered, or (without ACKs) no `0x40` within the gap
+        uint32_t retries   = 0;  // Resends after a `0x40` or a missing ACK
+        uint32_t failed    = 0;  // Given up: out of attempts or out of retry budget
+    };
+
+
+    // Where the health monitor stands (see `monitor()`)
+    enum class Health : uint8_t {
+        DISABLED,        // Not monitoring
+        OK,              // Answering
+        RETRYING,        // Missed one probe: probing again
+        RESETTING,       // Missed two: player reset
+        REINITIALIZING   // Still silent: init sequence and reset in turn, every interval until it answers
+    };
+
+
+    // Health monitor counters (see `get_health()`)
+    struct HealthStats {
+        Health        health            = Health::DISABLED;
+        uint8_t       misses            = 0;  // Consecutive probes not answered
+        uint32_t      probes            = 0;  // Status probes sent
+        uint32_t      outages           = 0;  // Times the player stopped answering
+        uint32_t      recoveries        = 0;  // Times it answered again
+        uint32_t      restarts          = 0;  // Power-on frames (`0x3F`): brownouts and resets
+        unsigned long silent_since_ms   = 0;  // `now_ms()` of the last frame before the current/last outage
+        unsigned long last_outage_ms    = 0;  // Silence of the last outage (last frame before it -> first answer)
+        unsigned long longest_outage_ms = 0;  // Longest silence so far
+    };
+
+
+    // What is known about the current track (see `watch_track()`)
+    struct NowPlaying {
+        bool          confirmed    = false;  // The player reported the track (`0x4C`) since it last changed
+        unsigned long changed_ms   = 0;      // `now_ms()` when the track last changed (command, event, or poll)
+        unsigned long confirmed_ms = 0;      // `now_ms()` of the last `0x4C` reply
+        unsigned long interval_ms  = 0;      // Current polling interval (`0`: not watching)
+        uint32_t      polls        = 0;      // `0x4C` queries sent
+        uint32_t      corrections  = 0;      // Replies that differed from the expected track
+    };
+
+
+    /**
+     * Clamps an integer to the specified byte range.
+     * @param value The integer value to clamp.
+     * @param low The lower bound.
+     * @param high The upper bound.
+     * @return The clamped integer, with type `uint8_t`.
+     **/
+    inline uint8_t clamp_u8(int value, int low, int high)
+    {
+        if (value < low) {
+            value = low;
+        }
+        if (value > high) {
+            value = high;
+        }
+        return static_cast<uint8_t>(value);
+    }
+
+
+    /**
+     * The whole protocol (queue, pacing, compaction, shadow state, queries, events), independent
+     * of where the bytes go. `Transport` is a policy class, called directly (no virtual dispatch):
+     *
+     *     size_t        write(const uint8_t* buf, size_t len);  // Write a whole frame
+     *     int           available();                            // Bytes waiting to be read
+     *     int           read();                                 // Next received byte, `-1` if none
+     *     unsigned long now_ms();                               // Monotonic time in ms
+     *     void          debug(const char* line);                // Print one line of debug output
+     *
+     * See `Transport.h` for the Arduino transports. A host mock only needs the same five members.
+     **/
+    template <typename Transport>
+    class Driver {
+    public:
+        explicit Driver(const Transport& transport);
+
+        void begin(bool debug = false);
+
+        void poll();
+        void receive();
+        bool is_idle() const;
+        unsigned long next_poll_in(unsigned long limit);
+
+        void set_ack_mode(bool enabled);
+
+        bool run_batch(const Step* steps, size_t count, BatchCallback callback = nullptr);
+
+        bool on_event(uint8_t event, EventCallback callback);
+
+        template <typename Cmd, typename... Args>
+        bool send(Args... args);
+
+        void play_next();
+        void play_previous();
+
+        void play_track(int track);
+
+        void play_track_in_folder(int folder, int track);
+
+        void loop_track(int track);
+
+        void loop_track_in_folder(int folder, int track);
+
+        // void play_folder(int folder);  // void playF(byte f);
+
+        void loop_folder(int folder);
+
+        void loop_all_tracks();
+
+        void shuffle_all_tracks();
+
+        void start_looping_current_track();
+        void stop_looping_current_track();
+
+        void set_folder(int folder);
+
+        void set_source(int source);
+
+        void increment_volume();
+        void decrement_volume();
+        void set_volume(int volume);
+        void set_power_on_volume(int volume);
+
+        void set_EQ(int eq);
+
+        void play();
+        void pause();
+        void stop_all_playback();
+
+        void reset();
+
+        void enable_DAC();
+        void disable_DAC();
+
+        void sleep();
+        void wakeup();
+
+        const State& get_state() const;
+        Playback     get_status() const;
+        uint16_t     get_volume() const;
+        uint16_t     get_folder_count() const;
+        uint16_t     get_folder_track_count() const;
+        uint16_t     get_total_track_count() const;
+
+        bool query(uint8_t command, QueryCallback callback, unsigned long timeout_ms = 1000);
+        bool query(uint8_t command, uint16_t param, QueryCallback callback, unsigned long timeout_ms = 1000);
+        void refresh(RefreshCallback callback = nullptr);
+
+        void              watch_track(unsigned long min_interval_ms = 500, unsigned long max_interval_ms = 30000);
+        uint16_t          get_currently_playing_track() const;
+        const NowPlaying& get_now_playing() const;
+
+        const CommandStats& get_stats(uint8_t command) const;
+
+        void               monitor(unsigned long interval_ms, const Step* init = nullptr, size_t init_count = 0);
+        const HealthStats& get_health() const;
+
+        bool           scan_catalog(CatalogCallback callback = nullptr);
+        bool           is_scanning_catalog() const;
+        const Catalog& get_catalog() const;
+
+        bool     calibrate(CalibrationCallback callback = nullptr);
+        bool     is_calibrating() const;
+        uint16_t get_gap(uint8_t command) const;
+        void     set_gap(uint8_t command, uint16_t gap_ms);
+
+    protected:
+        // Frame waiting in the transmit queue
+        struct Command {
+            uint8_t command;
+            uint8_t data1;
+            uint8_t data2;
+        };
+
+        // Part of the player state a command changes (see `_compact()`)
+        enum class CommandGroup : uint8_t {
+            NONE,
+            VOLUME,
+            EQ,
+            TRACK
+        };
+
+        // Query waiting for its reply
+        struct PendingQuery {
+            uint8_t       command    = 0;
+            QueryCallback callback   = nullptr;
+            unsigned long timeout_ms = 0;
+            unsigned long sent_ms    = 0;
+            bool          sent       = false;  // Frame is on the wire, timeout is running
+            bool          active     = false;  // Slot is in use
+        };
+
+        // Subscriber to unsolicited frames
+        struct Listener {
+            uint8_t       event    = 0;
+            EventCallback callback = nullptr;
+        };
+
+        // Last frame sent, kept until the player confirms it or the driver gives up.
+        // Frames are never sent past an unconfirmed one, so one is all that can be outstanding.
+        struct InFlight {
+            Command       cmd       = {};
+            uint8_t       attempts  = 0;
+            unsigned long sent_ms   = 0;
+            bool          active    = false;
+            bool          resend    = false;   // Waiting for `resend_ms` to send it again
+            unsigned long resend_ms = 0;
+        };
+
+        enum class CalibrationPhase : uint8_t {
+            IDLE,       // Not calibrating
+            SETTLING,   // Waiting for the player to finish with the last frames before the next step
+            PROBING     // Step sent, probing with status queries until the player answers
+        };
+
+        static constexpr uint8_t       TX_QUEUE_SIZE   = 16;   // Max. commands waiting to be sent
+        static constexpr uint8_t       MAX_QUERIES     = 8;    // Max. queries in flight
+        static constexpr uint8_t       MAX_LISTENERS   = 8;    // Max. event subscribers
+        static constexpr unsigned long TX_GAP_MS       = 500;  // Min. time after a frame not in the command table (ms)
+        static constexpr unsigned long ACK_GAP_MS      = 10;   // Min. time between an ACK and the next frame (ms)
+        static constexpr size_t        DEBUG_LINE_SIZE = 96;   // Max. length of one debug line
+        static constexpr uint8_t       MAX_ATTEMPTS    = 4;    // Sends of one frame before giving up
+        static constexpr unsigned long RETRY_BASE_MS   = 40;   // Backoff before the first resend, doubled each time
+        static constexpr unsigned long RETRY_MAX_MS    = 640;  // Max. backoff
+        static constexpr uint8_t       RETRY_BUDGET    = 8;    // Resends allowed in a burst
+        static constexpr unsigned long RETRY_REFILL_MS = 1000; // Time to earn back one resend
+        static constexpr uint8_t       STATS_SIZE      = 0x50; // Opcodes with counters (`0x00`..`0x4F`)
+        static constexpr uint8_t       MAX_CAL_STEPS   = 4;    // Commands measured by one `calibrate()` run
+        static constexpr uint8_t       CAL_ROUNDS      = 3;    // Measurements of each command (the slowest one counts)
+        static constexpr unsigned long CAL_PROBE_MS    = 15;   // Time between status probes
+        static constexpr unsigned long CAL_SETTLE_MS   = 250;  // Quiet time between measurements
+        static constexpr unsigned long CAL_TIMEOUT_MS  = 2000; // Time for the player to answer after a step
+        static constexpr unsigned long CAL_MARGIN_MS   = 10;   // Added to the slowest measurement (plus 25%)
+        static constexpr unsigned long PROBE_WAIT_MS   = 500;  // Time for the player to answer a health probe
+        static constexpr unsigned long REBOOT_MS       = 3000; // Time for the player to come back after a reset
+        static constexpr uint8_t       SCAN_WINDOW     = 4;    // Folder queries in flight during a catalog scan
+
+        // Progress of a `calibrate()` run
+        struct Calibration {
+            CalibrationPhase    phase    = CalibrationPhase::IDLE;
+            Command             steps[MAX_CAL_STEPS] = {};
+            uint8_t             count    = 0;      // Steps to measure
+            uint8_t             index    = 0;      // Step being measured
+            uint8_t             round    = 0;      // Measurements of it done
+            bool                ok       = true;   // Every step so far was measured
+            unsigned long       sent_ms  = 0;      // `now_ms()` when the step was sent
+            unsigned long       probe_ms = 0;      // `now_ms()` when the last probe was sent
+            unsigned long       ready_ms = 0;      // `now_ms()` when the next step may be sent
+            unsigned long       rtt_ms   = 0;      // Fastest status round trip (subtracted from every measurement)
+            Command             restore  = {};     // Plays the track again if it stopped (`command == 0`: none)
+            unsigned long       worst_ms = 0;      // Slowest measurement of the step
+            CalibrationCallback callback = nullptr;
+        };
+
+        // Health monitor settings and progress
+        struct Monitor {
+            unsigned long interval_ms = 0;        // Mean time between probes (`0`: disabled)
+            unsigned long next_ms     = 0;        // `now_ms()` of the next check
+            unsigned long heard_ms    = 0;        // `now_ms()` of the last frame received
+            const Step*   init        = nullptr;  // Sequence re-run after a reset
+            size_t        init_count  = 0;
+            State         saved;                  // State before the outage (restored after the init sequence)
+            bool          has_saved   = false;    // `saved` is from before the outage, restore it on the next `0x3F`
+            bool          probing     = false;    // A probe is waiting for its reply
+            bool          restarted   = false;    // The player sent `0x3F`: re-init when idle
+            uint32_t      seed        = 1;        // Interval jitter (xorshift)
+        };
+
+        // Now-playing polling settings and progress
+        struct TrackWatch {
+            unsigned long min_ms     = 0;      // Polling interval right after a change (`0`: not watching)
+            unsigned long max_ms     = 0;      // Longest interval, reached while the track stays the same
+            unsigned long next_ms    = 0;      // `now_ms()` of the next poll
+            bool          polling    = false;  // A `0x4C` query is waiting for its reply
+            bool          superseded = false;  // A track command was queued since: the reply is stale
+            bool          status_due = false;  // A track ended: ask for the playback status with the next poll
+        };
+
+        // Progress of a `scan_catalog()`
+        struct CatalogScan {
+            bool            active      = false;
+            bool            ok          = true;   // Every query so far was answered
+            uint8_t         counting    = 0;      // Count queries (total, folders) still outstanding
+            uint8_t         in_flight   = 0;      // Folder queries outstanding
+            uint8_t         next_folder = 1;      // Next folder to query
+            Catalog         result;               // Catalog being built
+            CatalogCallback callback    = nullptr;
+        };
+
+        Transport _transport;                    // Where the frames go (see class comment)
+        Parser    _parser;                       // Response parser (may be fed from a UART event task)
+        bool      _started             = false;  // `begin()` was called
+        bool      _rx_event_driven     = false;  // RX bytes are fed by the transport's callback, not `poll()`
+        bool      _show_debug_messages = false;  // Show debug flag
+
+        Command       _tx_queue[TX_QUEUE_SIZE];  // Pending commands (ring buffer)
+        uint8_t       _tx_head  = 0;             // Index of the oldest pending command
+        uint8_t       _tx_count = 0;             // Number of pending commands
+        unsigned long _last_tx_ms = 0;           // `now_ms()` when the last frame was sent
+
+        bool          _ack_mode     = false;     // Request feedback (`0x41`) for every frame
+        bool          _awaiting_ack = false;     // Last frame sent has not been acknowledged yet
+        uint8_t       _last_tx_cmd  = 0;         // Command byte of the last frame sent
+        unsigned long _ack_ms       = 0;         // `now_ms()` when the last acknowledgement arrived
+
+        State _state;                            // Shadow of the player's state (incl. queued commands)
+
+        PendingQuery    _queries[MAX_QUERIES];   // Queries waiting for their reply
+        uint8_t         _refresh_pending = 0;    // `refresh()` queries still outstanding
+        bool            _refresh_ok      = true; // Every completed `refresh()` query was answered
+        RefreshCallback _refresh_callback;       // Called when `_refresh_pending` drops to 0
+
+        Listener _listeners[MAX_LISTENERS];      // Event subscribers
+
+        BatchCallback _batch_callback;           // Called when the queue of a `run_batch()` drains
+
+        InFlight      _in_flight;                    // Last frame sent, until confirmed
+        uint8_t       _retry_tokens = RETRY_BUDGET;  // Resends left in the budget
+        unsigned long _refill_ms    = 0;             // `now_ms()` when the budget last earned a resend
+        CommandStats  _stats[STATS_SIZE + 1];        // Per-opcode delivery counters (last slot: anything else)
+
+        uint16_t _gaps[STATS_SIZE] = {};             // Measured gaps (`0`: use the command table)
+
+        Calibration _calibration;                    // Progress of a `calibrate()` run
+
+        Monitor     _monitor;                        // Health monitor (see `monitor()`)
+        HealthStats _health;                         // Health monitor counters
+
+        TrackWatch  _track_watch;                    // Now-playing polling (see `watch_track()`)
+        NowPlaying  _now_playing;                    // What is known about the current track
+
+        Catalog     _catalog;                        // Index of the card (scanned, or loaded from a cache)
+        CatalogScan _scan;                           // Progress of a `scan_catalog()`
+
+        void _debug(const char* format, ...) __attribute__((format(printf, 2, 3)));
+        void _print_hex(const char* prefix, const uint8_t* buf, size_t len);
+
+        void _handle_response(const Response& response);
+        void _dispatch_event(const Response& event);
+
+        bool _send_command(uint8_t command, uint8_t data1, uint8_t data2);
+
+        bool     _compact(const Command& cmd);
+        Command& _tx_at(uint8_t index);
+        void     _tx_remove(uint8_t index);
+
+        static CommandGroup  _group_of(uint8_t command);
+        static bool          _is_absolute(uint8_t command);
+        unsigned long        _gap_after(uint8_t command) const;
+
+        bool _can_transmit();
+        void _complete_query(const Response& response);
+        void _expire_queries();
+        void _transmit(const Command& cmd, bool resend = false);
+
+        void _check_in_flight();
+        void _resolve();
+        void _retry_or_fail(const char* reason);
+        bool _take_retry_token();
+        CommandStats& _stats_of(uint8_t command);
+        static bool   _is_retryable(uint8_t command);
+
+        void _calibrate_step();
+        void _calibration_reply(const Response& response);
+        void _calibration_send(uint8_t command, uint8_t data1, uint8_t data2);
+        void _calibration_next();
+        void _calibration_finish();
+        void _apply_gap(uint8_t command, uint16_t gap_ms);
+
+        void          _check_health();
+        void          _probe_health();
+        void          _probe_answered(bool ok);
+        bool          _reinitialize();
+        unsigned long _jittered_interval();
+
+        void _check_track();
+        void _track_changed();
+        void _track_reported(bool ok, uint16_t track, uint16_t expected);
+
+        void _scan_counted();
+        void _scan_folders();
+        void _scan_finish(bool changed);
+    };
+
+
+
+    /**
+     * Constructor for `Driver` class.
+     * @param transport The transport the frames are written to and read from.
+     **/
+    template <typename Transport>
+    Driver<Transport>::Driver(const Transport& transport) : _transport(transport) {}
+
+
+
+    /**
+     * Starts the driver once the transport is ready. Until then, commands are dropped.
+     * @param debug Show debug messages (through `Transport::debug()`) - default: `false`.
+     **/
+    template <typename Transport>
+    void Driver<Transport>::begin(bool debug)
+    {
+        _show_debug_messages = debug;
+        _started             = true;
+    }
+
+
+
+    /**
+     * Handles any frames received from the player, then sends the next queued
+     * command once the minimum inter-frame gap has passed.
+     * Never blocks - should be called repeatedly in the main loop.
+     **/
+    template <typename Transport>
+    void Driver<Transport>::poll()
+    {
+        if (!_started) {
+            return;
+        }
+
+        if (!_rx_event_driven) {
+            receive();
+        }
+
+        Response response;
+        while (_parser.pop(response)) {
+            _handle_response(response);
+        }
+
+        _expire_queries();
+        _check_in_flight();
+
+        // A calibration run owns the link once nothing is in flight; queued commands wait for it
+        if (_calibration.phase != CalibrationPhase::IDLE && !_in_flight.active) {
+            _calibrate_step();
+            return;
+        }
+
+        _check_health();
+        _check_track();
+
+        if (!_can_transmit()) {
+            return;
+        }
+
+        // A rejected frame goes again (after its backoff) before anything queued after it
+        if (_in_flight.resend) {
+            if (static_cast<long>(_transport.now_ms() - _in_flight.resend_ms) >= 0) {
+                _in_flight.resend = false;
+                _in_flight.attempts++;
+                _transmit(_in_flight.cmd, true);
+                _in_flight.sent_ms = _last_tx_ms;
+            }
+            return;
+        }
+
+        if (_calibration.phase != CalibrationPhase::IDLE) {
+            return;
+        }
+
+        if (_tx_count == 0) {
+            // Everything sent and acknowledged (or timed out): the batch is done
+            if (_batch_callback) {
+                BatchCallback done = _batch_callback;
+                _batch_callback = nullptr;
+                done();
+            }
+            return;
+        }
+
+        Command next = _tx_queue[_tx_head];
+        _tx_head = (_tx_head + 1) % TX_QUEUE_SIZE;
+        _tx_count--;
+
+        _transmit(next);
+        _stats_of(next.command).sent++;
+
+        if (_is_retryable(next.command)) {
+            _in_flight = { next, 1, _last_tx_ms, true, false, 0 };
+        }
+    }
+
+
+
+    /**
+     * Checks whether all queued commands have been sent.
+     * @return `true` if the transmit queue is empty.
+     **/
+    template <typename Transport>
+    bool Driver<Transport>::is_idle() const
+    {
+        return _tx_count == 0;
+    }
+
+
+
+    /**
+     * Returns how soon `poll()` has something to do: a response to handle, a frame to send or
+     * resolve, a query or calibration step timing out, a health probe or track poll due.
+     * Lets a caller that owns the driver sleep in between (frames received meanwhile are not
+     * covered: wake it from the receive side, see `DFPlayerMini::notify_on_receive()`).
+     * May be early (never late), e.g. a track poll due while the link is busy.
+     * @param limit The longest time to report (ms).
+     * @return The time until the next deadline (ms), `0` if it has passed.
+     **/
+    template <typename Transport>
+    unsigned long Driver<Transport>::next_poll_in(unsigned long limit)
+    {
+        if (!_started) {
+            return limit;
+        }
+        if (!_rx_event_driven || _parser.has_response()) {
+            return 0;
+        }
+
+        const unsigned long now = _transport.now_ms();
+        unsigned long wait = limit;
+        auto due = [&](unsigned long at_ms) {
+            const long left = static_cast<long>(at_ms - now);
+            const unsigned long ms = left > 0 ? static_cast<unsigned long>(left) : 0;
+            wait = ms < wait ? ms : wait;
+        };
+
+        // Next frame allowed on the wire
+        const unsigned long tx_ms = _ack_mode && !_awaiting_ack ? _ack_ms + ACK_GAP_MS
+                                                                : _last_tx_ms + _gap_after(_last_tx_cmd);
+
+        if (_in_flight.active) {
+            due(_in_flight.resend ? _in_flight.resend_ms : _in_flight.sent_ms + _gap_after(_in_flight.cmd.command));
+        }
+
+        for (const PendingQuery& pending : _queries) {
+            if (pending.active && pending.sent) {
+                due(pending.sent_ms + pending.timeout_ms);
+            }
+        }
+
+        if (_calibration.phase == CalibrationPhase::SETTLING) {
+            due(_calibration.ready_ms > tx_ms ? _calibration.ready_ms : tx_ms);
+        } else if (_calibration.phase == CalibrationPhase::PROBING) {
+            due(_calibration.probe_ms + CAL_PROBE_MS);
+            due(_calibration.sent_ms + CAL_TIMEOUT_MS);
+        }
+
+        if (_tx_count != 0) {
+            due(tx_ms);
+        } else if (_batch_callback) {
+            return 0;
+        }
+
+        // Background checks only run with the link idle
+        if (_tx_count == 0 && !_in_flight.active) {
+            if (_health.health != Health::DISABLED && !_monitor.probing) {
+                due(_monitor.restarted ? now : _monitor.next_ms);
+            }
+            const bool paused = _now_playing.confirmed && _state.playback != Playback::PLAYING && !_track_watch.status_due;
+            const bool healthy = _health.health == Health::DISABLED || _health.health == Health::OK;
+            if (_track_watch.min_ms != 0 && !_track_watch.polling && !_scan.active && healthy && !paused) {
+                due(_track_watch.next_ms);
+            }
+        }
+
+        return wait;
+    }
+
+
+
+    /**
+     * Queues a fixed sequence of commands, sent back-to-back at the minimum safe gap
+     * (or as soon as each is acknowledged, see `set_ack_mode()`).
+     * @param steps The commands to send, in order.
+     * @param count The number of commands.
+     * @param callback Called from `poll()` once the last command (and anything queued with it)
+     *                 has been sent and acknowledged or its gap has passed - default: none.
+     *                 A batch without one keeps the callback of an earlier batch still running
+     *                 (it then fires once both are sent).
+     * @return `false` if the transmit queue cannot hold the whole batch, or if both this batch
+     *         and a running one have a callback (nothing is queued).
+     **/
+    template <typename Transport>
+    bool Driver<Transport>::run_batch(const Step* steps, size_t count, BatchCallback callback)
+    {
+        if (!_started || count > static_cast<size_t>(TX_QUEUE_SIZE - _tx_count)) {
+            if (_show_debug_messages) {
+                _debug("DFPlayerMini: Batch does not fit in the transmit queue.");
+            }
+            return false;
+        }
+
+        // One callback at a time: replacing it would lose the earlier batch's
+        if (callback && _batch_callback) {
+            if (_show_debug_messages) {
+                _debug("DFPlayerMini: A batch with a callback is still running.");
+            }
+            return false;
+        }
+
+        for (size_t i = 0; i < count; i++) {
+            _send_command(steps[i].command, steps[i].data1, steps[i].data2);
+        }
+
+        if (callback) {
+            _batch_callback = callback;
+        }
+        return true;
+    }
+
+
+
+    /**
+     * Subscribes to unsolicited frames from the player, e.g. `0x3D` (track finished),
+     * `0x3A` (card inserted) or `0x3B` (card removed). Frames are parsed as soon as they
+     * arrive; callbacks run from the next `poll()`.
+     * @param event The event code (`0x3A`..`0x3F`), or `ANY_EVENT`.
+     * @param callback Called with the decoded frame.
+     * @return `false` if the subscriber table is full.
+     **/
+    template <typename Transport>
+    bool Driver<Transport>::on_event(uint8_t event, EventCallback callback)
+    {
+        for (Listener& listener : _listeners) {
+            if (!listener.callback) {
+                listener.event    = event;
+                listener.callback = callback;
+                return true;
+            }
+        }
+        return false;
+    }
+
+
+
+    /**
+     * Queues a command described in the command table (see `Descriptors.h`).
+     * Arguments given as `arg<N>` are range-checked at compile time, plain integers are
+     * clamped to the command's range, e.g. `send<op::SetVolume>(arg<20>)`.
+     * @param args The command's arguments (as many as its `arity`).
+     * @return `false` if the command was dropped (not started or queue full).
+     **/
+    template <typename Transport>
+    template <typename Cmd, typename... Args>
+    bool Driver<Transport>::send(Args... args)
+    {
+        const Step data = step<Cmd>(args...);
+        return _send_command(data.command, data.data1, data.data2);
+    }
+
+
+
+    /**
+     * Enables/disables ACK-gated sending. When enabled, every frame requests feedback and the
+     * next frame is released as soon as the player acknowledges (`0x41`) the previous one.
+     * A missing acknowledgement falls back to the command's gap.
+     * @param enabled `true` to request and wait for acknowledgements.
+     **/
+    template <typename Transport>
+    void Driver<Transport>::set_ack_mode(bool enabled)
+    {
+        _ack_mode     = enabled;
+        _awaiting_ack = false;
+    }
+
+
+
+    /**
+     * [ `0x01` ]
+     * 
+     * Plays the next track.
+     **/
+    template <typename Transport>
+    void Driver<Transport>::play_next()
+    {
+        send<op::Next>();
+    }
+
+
+
+    /**
+     * [ `0x02` ]
+     * 
+     * Plays the previous track.
+     **/
+    template <typename Transport>
+    void Driver<Transport>::play_previous()
+    {
+        send<op::Previous>();
+    }
+
+
+
+    /**
+     * [ `0x03` ]
+     * 
+     * Plays a specific track.
+     * @param track The track number to play.
+     **/
+    template <typename Transport>
+    void Driver<Transport>::play_track(int track)
+    {
+        send<op::PlayTrack>(track);
+    }
+
+
+
+    /**
+     * ```
+     * 0x0F
+     * ```
+     * 
+     * Plays a specific track in a specific folder.
+     * @param folder The folder number.
+     * @param track The track number to play.
+     **/
+    template <typename Transport>
+    void Driver<Transport>::play_track_in_folder(int folder, int track)
+    {
+        send<op::PlayTrackInFolder>(folder, track);
+    }
+
+
+
+    /**
+     * `0x08`
+     * 
+     * Loops a specific track indefinitely.
+     * @param track The track number to loop.
+     **/
+    template <typename Transport>
+    void Driver<Transport>::loop_track(int track)
+    {
+        send<op::LoopTrack>(track);
+    }
+
+
+
+    /**
+     * `0x08`
+     * 
+     * Loops a specific track in a specific folder indefinitely.
+     * @param folder The folder number.
+     * @param track The track number to loop.
+     **/
+    template <typename Transport>
+    void Driver<Transport>::loop_track_in_folder(int folder, int track)
+    {
+        send<op::LoopTrackInFolder>(folder, track);
+    }
+
+
+
+    /**
+     * `0x17`
+     * 
+     * Loops all tracks in a specific folder indefinitely.
+     * @param folder The folder number.
+     **/
+    template <typename Transport>
+    void Driver<Transport>::loop_folder(int folder)
+    {
+        send<op::LoopFolder>(folder);
+    }
+
+
+
+    /**
+     * `0x11`
+     * 
+     * Loops all tracks indefinitely.
+     **/
+    template <typename Transport>
+    void Driver<Transport>::loop_all_tracks()
+    {
+        send<op::LoopAll>();
+    }
+
+
+
+    /**
+     * `0x18`
+     * 
+     * Plays all tracks in random order.
+     **/
+    template <typename Transport>
+    void Driver<Transport>::shuffle_all_tracks()
+    {
+        send<op::Shuffle>();
+    }
+
+
+
+    /**
+     * `0x19`
+     * 
+     * Starts looping the current track indefinitely.
+     **/
+    template <typename Transport>
+    void Driver<Transport>::start_looping_current_track()
+    {
+        send<op::LoopCurrent>(arg<1>);
+    }
+
+
+
+    /**
+     * `0x19`
+     * 
+     * Stops looping the current track.
+     **/
+    template <typename Transport>
+    void Driver<Transport>::stop_looping_current_track()
+    {
+        send<op::LoopCurrent>(arg<0>);
+    }
+
+
+
+    /**
+     * `0x12`
+     * 
+     * Specifies the MP3 folder.
+     * @param folder The folder number.
+     **/
+    template <typename Transport>
+    void Driver<Transport>::set_folder(int folder)
+    {
+        send<op::SetFolder>(folder);
+    }
+
+
+
+    /**
+     * `0x09`
+     * 
+     * Specifies the playback source.
+     * @param source The source to set (`1`: USB Disk, `2`: SD Card, `3`: Aux, `4`: Flash, `5`: PC, `6`: Sleep). 
+     **/
+    template <typename Transport>
+    void Driver<Transport>::set_source(int source)
+    {
+        send<op::SetSource>(source);
+    }
+
+
+
+    /**
+     * `0x04`
+     * 
+     * Increases the volume by one step.
+     **/
+    template <typename Transport>
+    void Driver<Transport>::increment_volume()
+    {
+        send<op::VolumeUp>();
+    }
+
+
+
+    /**
+     * `0x05`
+     * 
+     * Decreases the volume by one step.
+     **/
+    template <typename Transport>
+    void Driver<Transport>::decrement_volume()
+    {
+        send<op::VolumeDown>();
+    }
+
+
+
+    /**
+     * `0x06`
+     * 
+     * Sets the volume (range from 0-30).
+     * @param volume The desired volume level.
+     **/
+    template <typename Transport>
+    void Driver<Transport>::set_volume(int volume)
+    {
+        send<op::SetVolume>(volume);
+    }
+
+
+
+    /**
+     * `0x1B`
+     * 
+     * Sets the power-on volume level (range from 0-30).
+     * @param volume The desired volume level (`24` seems to be practical maximum).
+     **/
+    template <typename Transport>
+    void Driver<Transport>::set_power_on_volume(int volume)
+    {
+        send<op::PowerOnVolume>(volume);
+    }
+
+
+
+    /**
+     * `0x07`
+     * 
+     * Sets the equalization.
+     * @param eq The desired EQ (`0`: Normal, `1`: Rock, `2`: ???, `3`: Pop, `4`: Classical, `5`: Country, `6`: Jazz).
+     **/
+    template <typename Transport>
+    void Driver<Transport>::set_EQ(int eq)
+    {
+        send<op::SetEQ>(eq);
+    }
+
+
+
+    /**
+     * `0x0D`
+     * 
+     * Plays/resumes playback.
+     **/
+    template <typename Transport>
+    void Driver<Transport>::play()
+    {
+        send<op::Play>();
+    }
+
+
+
+    /**
+     * `0x0E`
+     * 
+     * Pauses playback.
+     **/
+    template <typename Transport>
+    void Driver<Transport>::pause()
+    {
+        send<op::Pause>();
+    }
+
+
+
+    /**
+     * `0x16`
+     * 
+     * Stops all playback actions.
+     **/
+    template <typename Transport>
+    void Driver<Transport>::stop_all_playback()
+    {
+        send<op::Stop>();
+    }
+
+
+
+    /**
+     * `0x0C`
+     * 
+     * Resets the player.
+     **/
+    template <typename Transport>
+    void Driver<Transport>::reset()
+    {
+        send<op::Reset>();
+    }
+
+
+
+    /**
+     * `0x1A`
+     * 
+     * Enables the DAC (disables DAC high impedance).
+     **/
+    template <typename Transport>
+    void Driver<Transport>::enable_DAC()
+    {
+        send<op::DACHighImpedance>(arg<0>);
+    }
+
+
+
+    /**
+     * `0x1A`
+     * 
+     * Disables the DAC (enables DAC high impedance).
+     **/
+    template <typename Transport>
+    void Driver<Transport>::disable_DAC()
+    {
+        send<op::DACHighImpedance>(arg<1>);
+    }
+
+
+
+    /**
+     * `0x0A`
+     * 
+     * Puts the player in low-power (sleep) mode.
+     **/
+    template <typename Transport>
+    void Driver<Transport>::sleep()
+    {
+        send<op::Sleep>();
+    }
+
+
+
+    /**
+     * `0x0B`
+     * 
+     * Wakes the player from low-power (sleep) mode.
+     **/
+    template <typename Transport>
+    void Driver<Transport>::wakeup()
+    {
+        send<op::WakeUp>();
+    }
+
+
+
+    /**
+     * Returns everything known about the player (no UART traffic).
+     * @return The shadow of the player's state.
+     **/
+    template <typename Transport>
+    const State& Driver<Transport>::get_state() const
+    {
+        return _state;
+    }
+
+
+
+    /**
+     * Returns the playback status from the shadow state (no UART traffic).
+     * @return `Playback::PLAYING`, `PAUSED`, `STOPPED`, or `UNKNOWN`.
+     **/
+    template <typename Transport>
+    Playback Driver<Transport>::get_status() const
+    {
+        return _state.playback;
+    }
+
+
+
+    /**
+     * Returns the volume from the shadow state (no UART traffic).
+     * @return The volume (0-30), `UNKNOWN` if not known yet.
+     **/
+    template <typename Transport>
+    uint16_t Driver<Transport>::get_volume() const
+    {
+        return _state.volume;
+    }
+
+
+
+    /**
+     * Returns the number of folders from the shadow state (no UART traffic, see `refresh()`).
+     * @return The number of folders, `0` if not known yet.
+     **/
+    template <typename Transport>
+    uint16_t Driver<Transport>::get_folder_count() const
+    {
+        return _state.folder_count;
+    }
+
+
+
+    /**
+     * Returns the number of tracks in the current folder from the shadow state (no UART traffic).
+     * @return The number of tracks, `0` if not known yet.
+     **/
+    template <typename Transport>
+    uint16_t Driver<Transport>::get_folder_track_count() const
+    {
+        return _state.folder_track_count;
+    }
+
+
+
+    /**
+     * Returns the total number of tracks from the shadow state (no UART traffic, see `refresh()`).
+     * @return The total number of tracks, `0` if not known yet.
+     **/
+    template <typename Transport>
+    uint16_t Driver<Transport>::get_total_track_count() const
+    {
+        return _state.total_track_count;
+    }
+
+
+
+    /**
+     * Queues a query and returns right away. The callback runs from `poll()` when the reply
+     * (the frame with the same command byte) arrives, or when the timeout expires.
+     * @param command The query command byte (`0x42`..`0x4F`).
+     * @param callback Called with `(true, value)` on reply, `(false, 0)` on timeout.
+     * @param timeout_ms Time to wait for the reply once the query is sent - default: `1000`.
+     * @return `false` if the query could not be queued (callback will not be called).
+     **/
+    template <typename Transport>
+    bool Driver<Transport>::query(uint8_t command, QueryCallback callback, unsigned long timeout_ms)
+    {
+        return query(command, 0, callback, timeout_ms);
+    }
+
+
+
+    /**
+     * Queues a query with an argument, e.g. `0x4E` (tracks in a folder). Queries with the same
+     * command byte are answered in order, so several may be in flight at once.
+     * @param command The query command byte (`0x42`..`0x4F`).
+     * @param param The argument (sent in DATA1:DATA2).
+     * @param callback Called with `(true, value)` on reply, `(false, 0)` on timeout.
+     * @param timeout_ms Time to wait for the reply once the query is sent - default: `1000`.
+     * @return `false` if the query could not be queued (callback will not be called).
+     **/
+    template <typename Transport>
+    bool Driver<Transport>::query(uint8_t command, uint16_t param, QueryCallback callback, unsigned long timeout_ms)
+    {
+        const Descriptor* desc = descriptor(command);
+        if (desc == nullptr || !desc -> expects_reply) {
+            if (_show_debug_messages) {
+                _debug("DFPlayerMini: 0x%02X is not a query.", command);
+            }
+            return false;
+        }
+
+        PendingQuery* slot = nullptr;
+        for (PendingQuery& pending : _queries) {
+            if (!pending.active) {
+                slot = &pending;
+                break;
+            }
+        }
+
+        if (slot == nullptr) {
+            if (_show_debug_messages) {
+                _debug("DFPlayerMini: Too many queries in flight, query dropped.");
+            }
+            return false;
+        }
+
+        if (!_send_command(command, static_cast<uint8_t>(param >> 8), static_cast<uint8_t>(param & 0xFF))) {
+            return false;
+        }
+
+        slot -> command    = command;
+        slot -> callback   = callback;
+        slot -> timeout_ms = timeout_ms;
+        slot -> sent       = false;
+        slot -> active     = true;
+        return true;
+    }
+
+
+
+    /**
+     * `0x42`, `0x43`, `0x44`, `0x48`, `0x4F`
+     * 
+     * Re-syncs the shadow state with the player (status, volume, EQ, track and folder counts).
+     * Returns right away - the replies update the state from `poll()`.
+     * @param callback Called once every query has completed, with `true` if all were answered.
+     **/
+    template <typename Transport>
+    void Driver<Transport>::refresh(RefreshCallback callback)
+    {
+        static constexpr uint8_t queries[] = {
+            cmd::QRY_STATUS,
+            cmd::QRY_VOLUME,
+            cmd::QRY_EQUALIZATION,
+            cmd::QUERY_TOT_TRACKS,
+            cmd::QUERY_FLDR_COUNT
+        };
+
+        if (_refresh_pending == 0) {
+            _refresh_ok = true;
+        }
+        _refresh_callback = callback;
+
+        for (uint8_t command : queries) {
+            const bool queued = query(command, [this](bool ok, uint16_t) {
+                _refresh_ok = _refresh_ok && ok;
+                if (--_refresh_pending == 0 && _refresh_callback) {
+                    RefreshCallback done = _refresh_callback;
+                    _refresh_callback = nullptr;
+                    done(_refresh_ok);
+                }
+            });
+
+            if (queued) {
+                _refresh_pending++;
+            } else {
+                _refresh_ok = false;
+            }
+        }
+
+        if (_refresh_pending == 0 && _refresh_callback) {
+            RefreshCallback done = _refresh_callback;
+            _refresh_callback = nullptr;
+            done(false);
+        }
+    }
+
+
+
+    /**
+     * Queues a one-byte command with two bytes of data (sent later by `poll()`).
+     * @param command The command byte.
+     * @param data1 The first data byte.
+     * @param data2 The second data byte.
+     * @return `false` if the command was dropped (not initialized or queue full).
+     **/
+    template <typename Transport>
+    bool Driver<Transport>::_send_command(uint8_t command, uint8_t data1, uint8_t data2)
+    {
+        if (!_started) {
+            if (_show_debug_messages) {
+                _debug("DFPlayerMini: _send_command called before begin()");
+            }
+            return false;
+        }
+
+        // Fold relative volume steps into an absolute volume while the current volume is known
+        if ((command == cmd::VOL_UP || command == cmd::VOL_DOWN) && _state.volume <= 30) {
+            const int step = (command == cmd::VOL_UP) ? 1 : -1;
+            command = cmd::SET_VOL;
+            data1   = 0;
+            data2   = clamp_u8(_state.volume + step, 0, 30);
+        }
+
+        if (!_compact({ command, data1, data2 })) {
+            if (_tx_count == TX_QUEUE_SIZE) {
+                if (_show_debug_messages) {
+                    _debug("DFPlayerMini: Transmit queue full, command dropped.");
+                }
+                return false;
+            }
+
+            _tx_at(_tx_count) = { command, data1, data2 };
+            _tx_count++;
+        }
+
+        // Only once the command is sure to go out: a dropped one must not change the shadow state
+        _state.apply_command(command, data1, data2);
+
+        if (_group_of(command) == CommandGroup::TRACK) {
+            _track_changed();
+        }
+        return true;
+    }
+
+
+
+    /**
+     * Drops pending commands made obsolete by a new absolute command:
+     * - `SET_VOL` replaces a pending `SET_VOL`/`VOL_UP`/`VOL_DOWN` in place
+     * - `SET_EQ` replaces a pending `SET_EQ` in place
+     * - A new track selection removes pending track selections and `NEXT`/`PREVIOUS`
+     * @param cmd The command about to be queued.
+     * @return `true` if `cmd` took the place of a pending command (nothing left to queue).
+     **/
+    template <typename Transport>
+    bool Driver<Transport>::_compact(const Command& cmd)
+    {
+        const CommandGroup group = _group_of(cmd.command);
+
+        if (group == CommandGroup::NONE || !_is_absolute(cmd.command)) {
+            return false;
+        }
+
+        bool merged = false;
+        uint8_t i = 0;
+
+        while (i < _tx_count) {
+            Command& pending = _tx_at(i);
+
+            if (_group_of(pending.command) != group) {
+                i++;
+            }
+            else if (group != CommandGroup::TRACK && !merged) {
+                pending = cmd;
+                merged  = true;
+                i++;
+            }
+            else {
+                _tx_remove(i);
+            }
+        }
+
+        if (merged && _show_debug_messages) {
+            _debug("DFPlayerMini: Merged 0x%02X into a pending command.", cmd.command);
+        }
+
+        return merged;
+    }
+
+
+
+    /**
+     * Returns which part of the player state a command changes (used for queue compaction).
+     * @param command The command byte.
+     * @return The command's group, `CommandGroup::NONE` if it is never compacted.
+     **/
+    template <typename Transport>
+    typename Driver<Transport>::CommandGroup Driver<Transport>::_group_of(uint8_t command)
+    {
+        switch (command)
+        {
+            case cmd::VOL_UP:
+            case cmd::VOL_DOWN:
+            case cmd::SET_VOL:
+                return CommandGroup::VOLUME;
+
+            case cmd::SET_EQ:
+                return CommandGroup::EQ;
+
+            case cmd::NEXT:
+            case cmd::PREVIOUS:
+            case cmd::PLAY_N:
+            case cmd::PLAY_S_LOOP:
+            case cmd::PLAY_F_FILE:
+            case cmd::PLAY_LOOPS:
+            case cmd::FOLDER_CYCLE:
+            case cmd::PLAY_SHUFFLE:
+                return CommandGroup::TRACK;
+
+            default:
+                return CommandGroup::NONE;
+        }
+    }
+
+
+
+    /**
+     * Checks whether a command sets its state outright (rather than relative to the current state).
+     * @param command The command byte.
+     * @return `false` for `VOL_UP`, `VOL_DOWN`, `NEXT` and `PREVIOUS`.
+     **/
+    template <typename Transport>
+    bool Driver<Transport>::_is_absolute(uint8_t command)
+    {
+        return command != cmd::VOL_UP
+            && command != cmd::VOL_DOWN
+            && command != cmd::NEXT
+            && command != cmd::PREVIOUS;
+    }
+
+
+
+    /**
+     * Returns the pending command at a position in the transmit queue.
+     * @param index Position in the queue (`0` is the next command to be sent).
+     **/
+    template <typename Transport>
+    typename Driver<Transport>::Command& Driver<Transport>::_tx_at(uint8_t index)
+    {
+        return _tx_queue[(_tx_head + index) % TX_QUEUE_SIZE];
+    }
+
+
+
+    /**
+     * Removes a pending command from the transmit queue, keeping the order of the others.
+     * @param index Position in the queue (`0` is the next command to be sent).
+     **/
+    template <typename Transport>
+    void Driver<Transport>::_tx_remove(uint8_t index)
+    {
+        for (uint8_t i = index; i + 1 < _tx_count; i++) {
+            _tx_at(i) = _tx_at(i + 1);
+        }
+        _tx_count--;
+    }
+
+
+
+    /**
+     * Checks whether the next frame may be sent: right after the previous one was acknowledged
+     * (ACK mode), otherwise once the previous command's gap (see `Descriptors.h`) has passed.
+     * @return `true` if a frame may be sent now.
+     **/
+    template <typename Transport>
+    bool Driver<Transport>::_can_transmit()
+    {
+        const unsigned long now = _transport.now_ms();
+
+        if (_ack_mode && !_awaiting_ack) {
+            return now - _ack_ms >= ACK_GAP_MS;
+        }
+
+        return now - _last_tx_ms >= _gap_after(_last_tx_cmd);
+    }
+
+
+
+    /**
+     * Returns the minimum time between a frame and the next one: the measured gap (see `calibrate()`),
+     * otherwise the one from the command table.
+     * @param command The command byte of the frame sent.
+     * @return The gap (ms), `TX_GAP_MS` for commands in neither.
+     **/
+    template <typename Transport>
+    unsigned long Driver<Transport>::_gap_after(uint8_t command) const
+    {
+        if (command < STATS_SIZE && _gaps[command] != 0) {
+            return _gaps[command];
+        }
+
+        const Descriptor* desc = descriptor(command);
+        return desc != nullptr ? desc -> gap_ms : TX_GAP_MS;
+    }
+
+
+
+    /**
+     * Writes a single frame to the DFPlayer Mini and records when it was sent.
+     * @param cmd The command (and data bytes) to send.
+     * @param resend `true` for a frame the player rejected (`0x40`), sent again.
+     **/
+    template <typename Transport>
+    void Driver<Transport>::_transmit(const Command& cmd, bool resend)
+    {
+        frame::Frame frame;
+        const frame::Frame* send_frame = nullptr;
+
+        // Data-less commands use the precomputed frames in flash (built without the feedback bit)
+        if (!_ack_mode && cmd.data1 == 0 && cmd.data2 == 0) {
+            send_frame = frame::fixed(cmd.command);
+        }
+
+        if (send_frame == nullptr) {
+            frame = frame::make(
+                cmd.command, cmd.data1, cmd.data2,
+                _ack_mode ? frame::ACK : frame::NO_ACK
+            );
+            send_frame = &frame;
+        }
+
+        _transport.write(send_frame -> bytes, frame::SIZE);
+        _last_tx_ms   = _transport.now_ms();
+        _last_tx_cmd  = cmd.command;
+        _awaiting_ack = _ack_mode;
+
+        // Start the timeout of the oldest query waiting for this frame. Not on a resend: that
+        // query is already marked sent, and another one with the same opcode is still queued
+        PendingQuery* oldest = nullptr;
+        for (PendingQuery& pending : _queries) {
+            if (pending.active && !pending.sent && pending.command == cmd.command) {
+                oldest = &pending;
+                break;
+            }
+        }
+        if (oldest != nullptr && !resend) {
+            oldest -> sent    = true;
+            oldest -> sent_ms = _last_tx_ms;
+        }
+
+        if (_show_debug_messages) {
+            _print_hex("Sending: ", send_frame -> bytes, frame::SIZE);     // Display hex bytes sent to DFPlayer
+        }
+    }
+
+
+
+    /**
+     * Calls every listener subscribed to an unsolicited frame.
+     * @param event The decoded frame (`0x3A`..`0x3F`).
+     **/
+    template <typename Transport>
+    void Driver<Transport>::_dispatch_event(const Response& event)
+    {
+        for (Listener& listener : _listeners) {
+            if (listener.callback && (listener.event == ANY_EVENT || listener.event == event.cmd)) {
+                listener.callback(event);
+            }
+        }
+    }
+
+
+
+    /**
+     * Prints a line of debug output through the transport (formatted on the stack, no heap allocation).
+     * @param format The `printf`-style format, followed by its arguments.
+     **/
+    template <typename Transport>
+    void Driver<Transport>::_debug(const char* format, ...)
+    {
+        char line[DEBUG_LINE_SIZE];
+
+        va_list args;
+        va_start(args, format);
+        vsnprintf(line, sizeof(line), format, args);
+        va_end(args);
+
+        _transport.debug(line);
+    }
+
+
+
+    /**
+     * Prints a buffer as hexadecimal bytes (debug output only, no heap allocation).
+     * @param prefix Text printed before the bytes.
+     * @param buf The bytes to print.
+     * @param len The number of bytes.
+     **/
+    template <typename Transport>
+    void Driver<Transport>::_print_hex(const char* prefix, const uint8_t* buf, size_t len)
+    {
+        char   line[DEBUG_LINE_SIZE];
+        size_t used = snprintf(line, sizeof(line), "%s", prefix);
+
+        for (size_t i = 0; i < len && used + 5 < sizeof(line); i++) {
+            used += snprintf(line + used, sizeof(line) - used, "0X%02X ", buf[i]);
+        }
+
+        _transport.debug(line);
+    }
+
+
+
+    /**
+     * Feeds every byte waiting in the transport to the response parser.
+     * Called by `poll()`, or from the transport's RX callback (see `_rx_event_driven`).
+     **/
+    template <typename Transport>
+    void Driver<Transport>::receive()
+    {
+        while (_transport.available() > 0) {
+            _parser.feed(static_cast<uint8_t>(_transport.read()));
+        }
+    }
+
+
+
+    /**
+     * Handles a frame received from the player (query reply, event, error, or acknowledgement).
+     * @param response The decoded frame.
+     **/
+    template <typename Transport>
+    void Driver<Transport>::_handle_response(const Response& response)
+    {
+        // The player restarted (power glitch, or a reset) and lost its settings
+        if (response.cmd == cmd::SEND_INIT_PARAMS && _health.health != Health::DISABLED) {
+            _monitor.restarted = true;
+        }
+        _monitor.heard_ms = _transport.now_ms();
+
+        // A track reply that predates our last track command would undo it
+        if (!(response.cmd == cmd::QRY_TRACK_SD_CARD && _track_watch.superseded)) {
+            _state.apply_response(response);
+        }
+
+        // At the end of a track the player may have moved on (loop all, shuffle) or stopped
+        if (response.cmd == cmd::QU_TF_SD_COMPL) {
+            _track_changed();
+            _track_watch.status_due = true;
+        }
+
+        _complete_query(response);
+
+        if (_calibration.phase == CalibrationPhase::PROBING) {
+            _calibration_reply(response);
+        }
+
+        if (response.cmd >= cmd::QU_DEV_INSERTED && response.cmd <= cmd::SEND_INIT_PARAMS) {
+            _dispatch_event(response);
+        }
+
+        // Confirmation of the frame in flight, or a request to send it again
+        if (_in_flight.active && !_in_flight.resend) {
+            if (response.cmd == cmd::ERROR_RESEND) {
+                _retry_or_fail("0x40");
+            }
+            else if (response.cmd == cmd::RESPONSE || response.cmd == _in_flight.cmd.command) {
+                _resolve();
+            }
+        }
+
+        // Acknowledgement, error, or reply to the last frame: the player is done with it
+        if (_awaiting_ack && (
+                response.cmd == cmd::RESPONSE ||
+                response.cmd == cmd::ERROR_RESEND ||
+                response.cmd == _last_tx_cmd)) {
+            _awaiting_ack = false;
+            _ack_ms = _transport.now_ms();
+        }
+
+        if (!_show_debug_messages) {
+            return;
+        }
+
+        switch (response.cmd)
+        {
+            /*
+            * 0x3A == Device insertion (SD / USB / Flash device)
+            * 0x3B == Device unplugged
+            * 0x3C == UDISK Playback Completed
+            * 0x3D == SD card playback completed
+            * 0x3E == Flash playback completed
+            * 0x3F == Send initialization parameters (set player status)
+            */
+            case cmd::QU_DEV_INSERTED:
+                _debug("Memory card inserted.");
+                break;
+
+            case cmd::QU_DEV_UNPLUGGED:
+                _debug("Device unplugged.");
+                break;
+
+            case cmd::QU_UDISK_COMPL:
+                _debug("UDISK Playback Completed");
+                break;
+
+            case cmd::QU_TF_SD_COMPL:
+                _debug("SD Card Playback Completed");
+                break;
+
+            case cmd::QU_FLASH_COMPL:
+                _debug("Flash Playback Completed");
+                break;
+
+            case cmd::SEND_INIT_PARAMS:
+                _debug("Sent initialization parameters");
+                break;
+
+            /*
+            * 0x40 == Return error, request resend
+            * 0x41 == Response
+            */
+            case cmd::ERROR_RESEND:
+                _debug("Error, resend!");
+                break;
+
+            case cmd::RESPONSE:
+                _debug("Response received.");
+                break;
+
+            default:
+                _debug("Received: 0x%02X (data: %u)", response.cmd, response.param);
+                break;
+        }
+    }
+
+
+
+    /**
+     * Hands a reply to the query waiting for it, if any (the oldest one sent with the same command byte).
+     * @param response The decoded frame.
+     **/
+    template <typename Transport>
+    void Driver<Transport>::_complete_query(const Response& response)
+    {
+        PendingQuery* match = nullptr;
+
+        for (PendingQuery& pending : _queries) {
+            if (pending.active && pending.sent && pending.command == response.cmd) {
+                if (match == nullptr || static_cast<long>(pending.sent_ms - match -> sent_ms) < 0) {
+                    match = &pending;
+                }
+            }
+        }
+
+        if (match == nullptr) {
+            return;
+        }
+
+        // Free the slot before calling back, so the callback may issue new queries
+        QueryCallback callback = match -> callback;
+        match -> active   = false;
+        match -> callback = nullptr;
+
+        if (callback) {
+            callback(true, response.param);
+        }
+    }
+
+
+
+    /**
+     * Reports every query whose reply did not arrive in time.
+     **/
+    template <typename Transport>
+    void Driver<Transport>::_expire_queries()
+    {
+        const unsigned long now = _transport.now_ms();
+
+        for (PendingQuery& pending : _queries) {
+            if (!pending.active || !pending.sent || now - pending.sent_ms < pending.timeout_ms) {
+                continue;
+            }
+
+            if (_show_debug_messages) {
+                _debug("DFPlayerMini: No reply to query 0x%02X", pending.command);
+            }
+
+            QueryCallback callback = pending.callback;
+            pending.active   = false;
+            pending.callback = nullptr;
+
+            if (callback) {
+                callback(false, 0);
+            }
+        }
+    }
+
+
+
+    /**
+     * Returns the delivery counters of a command (sent, succeeded, retried, failed).
+     * @param command The command byte.
+     * @return The counters (all zero for a command never sent).
+     **/
+    template <typename Transport>
+    const CommandStats& Driver<Transport>::get_stats(uint8_t command) const
+    {
+        static const CommandStats none;
+        return command < STATS_SIZE ? _stats[command] : none;
+    }
+
+
+    /**
+     * Measures, on the connected player, how soon each common command is ready for the next frame,
+     * and uses those gaps instead of the command table from then on (see `get_gap()`).
+     *
+     * Only commands that leave what is heard unchanged are measured, each sent with the value the
+     * player already has: volume, EQ, and the source if nothing is playing (`SET_SOURCE` stops
+     * playback on this chip). Track and pause/play commands would restart or interrupt the track,
+     * so they keep their table gaps. After each command the player is probed with status queries:
+     * the first one answered marks the end of the command's processing. The slowest of `CAL_ROUNDS`
+     * measurements plus a margin becomes the gap, shared with the commands that change the same
+     * part of the state. A command whose value is not known yet keeps its table gap.
+     * If a known track was playing and the last status reply says it no longer is, it is played
+     * again once at the end.
+     *
+     * Never blocks: runs from `poll()`, holding queued commands until it is done.
+     * @param callback Called when the run ends (`ok == false` if the player stopped answering).
+     * @return `false` if not started or a run is already in progress.
+     **/
+    template <typename Transport>
+    bool Driver<Transport>::calibrate(CalibrationCallback callback)
+    {
+        if (!_started || _calibration.phase != CalibrationPhase::IDLE) {
+            return false;
+        }
+
+        _calibration = Calibration();
+        Command* steps = _calibration.steps;
+        uint8_t& count = _calibration.count;
+
+        // The status query goes first: its round trip is subtracted from every other measurement
+        steps[count++] = { cmd::QRY_STATUS, 0, 0 };
+
+        if (_state.volume != UNKNOWN) {
+            steps[count++] = { cmd::SET_VOL, 0, _state.volume };
+        }
+        if (_state.eq != UNKNOWN) {
+            steps[count++] = { cmd::SET_EQ, 0, _state.eq };
+        }
+
+        // `SET_SOURCE` stops playback: only with nothing to stop
+        if (_state.source != UNKNOWN && _state.playback == Playback::STOPPED) {
+            steps[count++] = { cmd::SET_SOURCE, 0, _state.source };
+        }
+
+        // Played again at the end only if the probes find it stopped
+        if (_state.track != 0 && _state.playback == Playback::PLAYING) {
+            _calibration.restore = {
+                _state.looping ? cmd::PLAY_S_LOOP : cmd::PLAY_N,
+                static_cast<uint8_t>(_state.track >> 8),
+                static_cast<uint8_t>(_state.track & 0xFF)
+            };
+        }
+
+        _calibration.callback = callback;
+        _calibration.ready_ms = _transport.now_ms();
+        _calibration.phase    = CalibrationPhase::SETTLING;
+
+        if (_show_debug_messages) {
+            _debug("Calibrating %u commands...", count);
+        }
+        return true;
+    }
+
+
+
+    /**
+     * Checks whether a `calibrate()` run is in progress.
+     * @return `true` while calibrating (queued commands are held).
+     **/
+    template <typename Transport>
+    bool Driver<Transport>::is_calibrating() const
+    {
+        return _calibration.phase != CalibrationPhase::IDLE;
+    }
+
+
+
+    /**
+     * Starts (or stops) watching the player in the background. Whenever nothing has been heard
+     * from it for about `interval_ms` (±25%, so several boxes do not probe in step) and the driver
+     * is idle, a status query is sent. Consecutive misses escalate:
+     * 1. probe again right away,
+     * 2. `reset()`,
+     * 3. re-run `init` followed by the volume, EQ and track from before the outage, then reset
+     *    and re-run in turn, every interval until the player answers (a reset instead of a
+     *    re-run when the transmit queue has no room for it).
+     *
+     * Whenever the player restarts (`0x3F`: a brownout, or one of those resets), it has lost its
+     * settings: `init` and the state from before are sent again as soon as the link is idle.
+     * How long the player was silent is recorded (see `get_health()`).
+     * @param interval_ms Mean time between probes (ms), `0` to stop monitoring.
+     * @param init The player's init sequence (must outlive the driver, e.g. `static constexpr`) - default: none.
+     * @param init_count The number of steps in `init`.
+     **/
+    template <typename Transport>
+    void Driver<Transport>::monitor(unsigned long interval_ms, const Step* init, size_t init_count)
+    {
+        const unsigned long now = _transport.now_ms();
+
+        _monitor.interval_ms = interval_ms;
+        _monitor.init        = init;
+        _monitor.init_count  = init_count;
+        _monitor.heard_ms    = now;
+        _monitor.seed        = static_cast<uint32_t>(now) | 1;
+        _monitor.next_ms     = now + _jittered_interval();
+
+        _health.health = interval_ms != 0 ? Health::OK : Health::DISABLED;
+        _health.misses = 0;
+    }
+
+
+
+    /**
+     * Returns the health monitor's state and counters.
+     * @return The counters (see `HealthStats`).
+     **/
+    template <typename Transport>
+    const HealthStats& Driver<Transport>::get_health() const
+    {
+        return _health;
+    }
+
+
+
+    /**
+     * Starts (or stops) following the current track. The track is updated as soon as a command
+     * changes it, then confirmed with `0x4C` queries when the link is idle: `min_interval_ms`
+     * after a change, then twice as long each time the answer is the same, up to
+     * `max_interval_ms`. A track end (`0x3D`) counts as a change. Nothing is polled while
+     * playback is stopped or paused and the track is confirmed.
+     * @param min_interval_ms Polling interval right after a change (ms), `0` to stop - default: `500`.
+     * @param max_interval_ms Polling interval while the track stays the same (ms) - default: `30000`.
+     **/
+    template <typename Transport>
+    void Driver<Transport>::watch_track(unsigned long min_interval_ms, unsigned long max_interval_ms)
+    {
+        _track_watch.min_ms  = min_interval_ms;
+        _track_watch.max_ms  = max_interval_ms > min_interval_ms ? max_interval_ms : min_interval_ms;
+        _track_watch.next_ms = _transport.now_ms();
+
+        _now_playing.confirmed   = false;
+        _now_playing.interval_ms = min_interval_ms;
+    }
+
+
+
+    /**
+     * Returns the current track from the shadow state (no UART traffic, see `watch_track()`).
+     * @return The track, `0` if not known yet.
+     **/
+    template <typename Transport>
+    uint16_t Driver<Transport>::get_currently_playing_track() const
+    {
+        return _state.track;
+    }
+
+
+
+    /**
+     * Returns how fresh the current track is: whether the player confirmed it, and when.
+     * @return The now-playing details (see `NowPlaying`).
+     **/
+    template <typename Transport>
+    const NowPlaying& Driver<Transport>::get_now_playing() const
+    {
+        return _now_playing;
+    }
+
+
+
+    /**
+     * `0x48`, `0x4F`, then `0x4E` for each folder
+     *
+     * Indexes the card: asks for the total track and folder counts, and if they match the
+     * catalog already held (see `catalog_fingerprint()`), keeps it. Otherwise asks every folder
+     * for its track count, `SCAN_WINDOW` queries at a time, and replaces the catalog once all
+     * have been answered. Returns right away - runs from `poll()`.
+     * @param callback Called when done, with `ok == false` if a query went unanswered (the
+     *                 previous catalog is kept) and `changed == true` if the catalog was replaced.
+     * @return `false` if not started or a scan is already running.
+     **/
+    template <typename Transport>
+    bool Driver<Transport>::scan_catalog(CatalogCallback callback)
+    {
+        if (!_started || _scan.active) {
+            return false;
+        }
+
+        _scan = CatalogScan();
+        _scan.active   = true;
+        _scan.callback = callback;
+
+        const bool total_queued = query(cmd::QRY_TOTAL_FILES_TFC, [this](bool ok, uint16_t value) {
+            _scan.ok = _scan.ok && ok;
+            _scan.result.total_tracks = value;
+            if (--_scan.counting == 0) {
+                _scan_counted();
+            }
+        });
+        _scan.counting += total_queued ? 1 : 0;
+
+        const bool folders_queued = query(cmd::QUERY_FLDR_COUNT, [this](bool ok, uint16_t value) {
+            _scan.ok = _scan.ok && ok;
+            _scan.result.folder_count = static_cast<uint8_t>(value < MAX_FOLDERS ? value : MAX_FOLDERS);
+            if (--_scan.counting == 0) {
+                _scan_counted();
+            }
+        });
+        _scan.counting += folders_queued ? 1 : 0;
+
+        if (!total_queued || !folders_queued) {
+            _scan.ok = false;
+            if (_scan.counting == 0) {
+                _scan_finish(false);
+            }
+        }
+        return true;
+    }
+
+
+
+    /**
+     * Checks whether a `scan_catalog()` is running.
+     * @return `true` while scanning.
+     **/
+    template <typename Transport>
+    bool Driver<Transport>::is_scanning_catalog() const
+    {
+        return _scan.active;
+    }
+
+
+
+    /**
+     * Returns the index of the card, as of the last successful `scan_catalog()` (or as loaded
+     * from a cache). Reading it never touches the UART.
+     * @return The catalog (`fingerprint == 0` if there is none yet).
+     **/
+    template <typename Transport>
+    const Catalog& Driver<Transport>::get_catalog() const
+    {
+        return _catalog;
+    }
+
+
+
+    /**
+     * Returns the minimum time the driver leaves after a command before sending the next frame.
+     * @param command The command byte.
+     * @return The measured gap if calibrated, otherwise the one from the command table (ms).
+     **/
+    template <typename Transport>
+    uint16_t Driver<Transport>::get_gap(uint8_t command) const
+    {
+        return static_cast<uint16_t>(_gap_after(command));
+    }
+
+
+
+    /**
+     * Overrides the gap after a command, e.g. with a profile measured earlier (see `calibrate()`).
+     * @param command The command byte (`0x00`..`0x4F`).
+     * @param gap_ms The gap (ms), `0` to go back to the command table.
+     **/
+    template <typename Transport>
+    void Driver<Transport>::set_gap(uint8_t command, uint16_t gap_ms)
+    {
+        if (command < STATS_SIZE) {
+            _gaps[command] = gap_ms;
+        }
+    }
+
+
+
+    /**
+     * Resolves the frame in flight once its time is up: without ACKs, no `0x40` within the
+     * inter-frame gap means success; with ACKs, no acknowledgement means it was lost.
+     **/
+    template <typename Transport>
+    void Driver<Transport>::_check_in_flight()
+    {
+        if (!_in_flight.active || _in_flight.resend || _transport.now_ms() - _in_flight.sent_ms < _gap_after(_in_flight.cmd.command)) {
+            return;
+        }
+
+        if (_ack_mode) {
+            _awaiting_ack = false;
+            _retry_or_fail("no ACK");
+        } else {
+            _resolve();
+        }
+    }
+
+
+
+    /**
+     * Counts the frame in flight as delivered.
+     **/
+    template <typename Transport>
+    void Driver<Transport>::_resolve()
+    {
+        _stats_of(_in_flight.cmd.command).succeeded++;
+        _in_flight.active = false;
+    }
+
+
+
+    /**
+     * Schedules a resend of the frame in flight with exponential backoff
+     * (`RETRY_BASE_MS`, doubled per attempt, up to `RETRY_MAX_MS`), or gives up once
+     * it has been sent `MAX_ATTEMPTS` times or the retry budget is spent.
+     * @param reason What went wrong (debug output only).
+     **/
+    template <typename Transport>
+    void Driver<Transport>::_retry_or_fail(const char* reason)
+    {
+        CommandStats& stats = _stats_of(_in_flight.cmd.command);
+
+        if (_in_flight.attempts >= MAX_ATTEMPTS || !_take_retry_token()) {
+            stats.failed++;
+            _in_flight.active = false;
+            if (_show_debug_messages) {
+                _debug("DFPlayerMini: 0x%02X failed (%s) after %u attempts.", _in_flight.cmd.command, reason, _in_flight.attempts);
+            }
+            return;
+        }
+
+        unsigned long backoff = RETRY_BASE_MS << (_in_flight.attempts - 1);
+        if (backoff > RETRY_MAX_MS) {
+            backoff = RETRY_MAX_MS;
+        }
+
+        stats.retries++;
+        _in_flight.resend    = true;
+        _in_flight.resend_ms = _transport.now_ms() + backoff;
+
+        if (_show_debug_messages) {
+            _debug("DFPlayerMini: 0x%02X %s, resending in %lu ms.", _in_flight.cmd.command, reason, backoff);
+        }
+    }
+
+
+
+    /**
+     * Spends one resend from the budget, which refills by one every `RETRY_REFILL_MS`.
+     * Keeps a player that rejects everything from being flooded with resends.
+     * @return `false` if the budget is empty.
+     **/
+    template <typename Transport>
+    bool Driver<Transport>::_take_retry_token()
+    {
+        const unsigned long now = _transport.now_ms();
+
+        while (_retry_tokens < RETRY_BUDGET && now - _refill_ms >= RETRY_REFILL_MS) {
+            _retry_tokens++;
+            _refill_ms += RETRY_REFILL_MS;
+        }
+        if (_retry_tokens == RETRY_BUDGET) {
+            _refill_ms = now;
+        }
+
+        if (_retry_tokens == 0) {
+            return false;
+        }
+        _retry_tokens--;
+        return true;
+    }
+
+
+
+    /**
+     * Returns the counters of a command (opcodes past `0x4F` share one extra slot).
+     * @param command The command byte.
+     **/
+    template <typename Transport>
+    CommandStats& Driver<Transport>::_stats_of(uint8_t command)
+    {
+        return _stats[command < STATS_SIZE ? command : STATS_SIZE];
+    }
+
+
+
+    /**
+     * Checks whether a command may be sent again when it is not confirmed.
+     * @param command The command byte.
+     * @return `false` for `RESET` and `SET_BAUD_RATE`, which restart the player (no confirmation).
+     **/
+    template <typename Transport>
+    bool Driver<Transport>::_is_retryable(uint8_t command)
+    {
+        return command != cmd::RESET && command != cmd::SET_BAUD_RATE;
+    }
+
+
+
+    /**
+     * Advances a `calibrate()` run: sends the next step once the player has settled,
+     * then probes with status queries until it answers (or gives up on the step).
+     **/
+    template <typename Transport>
+    void Driver<Transport>::_calibrate_step()
+    {
+        const unsigned long now = _transport.now_ms();
+
+        if (_calibration.phase == CalibrationPhase::SETTLING) {
+            if (static_cast<long>(now - _calibration.ready_ms) < 0 || !_can_transmit()) {
+                return;
+            }
+            if (_calibration.index >= _calibration.count) {
+                _calibration_finish();
+                return;
+            }
+
+            const Command& step = _calibration.steps[_calibration.index];
+            _calibration_send(step.command, step.data1, step.data2);
+            _calibration.sent_ms  = now;
+            _calibration.probe_ms = now;
+            _calibration.phase    = CalibrationPhase::PROBING;
+            return;
+        }
+
+        const Command& step = _calibration.steps[_calibration.index];
+
+        if (now - _calibration.sent_ms > CAL_TIMEOUT_MS) {
+            if (_show_debug_messages) {
+                _debug("Calibration: no answer after 0x%02X, keeping %lu ms", step.command, _gap_after(step.command));
+            }
+            _calibration.ok = false;
+
+            // Without a status round trip there is nothing to measure against
+            if (_calibration.index == 0) {
+                _calibration.index = _calibration.count - 1;
+            }
+            _calibration_next();
+            return;
+        }
+
+        // A query is its own probe
+        if (step.command != cmd::QRY_STATUS && now - _calibration.probe_ms >= CAL_PROBE_MS) {
+            _calibration_send(cmd::QRY_STATUS, 0, 0);
+            _calibration.probe_ms = now;
+        }
+    }
+
+
+
+    /**
+     * Takes a measurement from the first status reply after a calibration step.
+     * Replies to later probes arrive while settling and are ignored.
+     * @param response The decoded frame.
+     **/
+    template <typename Transport>
+    void Driver<Transport>::_calibration_reply(const Response& response)
+    {
+        if (response.cmd != cmd::QRY_STATUS) {
+            return;
+        }
+
+        const unsigned long now     = _transport.now_ms();
+        const unsigned long elapsed = now - _calibration.sent_ms;
+        unsigned long measured      = elapsed;
+
+        if (_calibration.index == 0) {
+            if (_calibration.round == 0 || elapsed < _calibration.rtt_ms) {
+                _calibration.rtt_ms = elapsed;
+            }
+        } else {
+            measured = elapsed > _calibration.rtt_ms ? elapsed - _calibration.rtt_ms : 0;
+        }
+
+        if (measured > _calibration.worst_ms) {
+            _calibration.worst_ms = measured;
+        }
+
+        _calibration.phase    = CalibrationPhase::SETTLING;
+        _calibration.ready_ms = now + CAL_SETTLE_MS;
+
+        if (++_calibration.round < CAL_ROUNDS) {
+            return;
+        }
+
+        const Command& step = _calibration.steps[_calibration.index];
+        const unsigned long gap = _calibration.worst_ms + _calibration.worst_ms / 4 + CAL_MARGIN_MS;
+        if (_show_debug_messages) {
+            _debug("Calibration: 0x%02X ready after %lu ms, gap %lu ms (table: %u ms)",
+                   step.command, _calibration.worst_ms, gap, descriptor(step.command) -> gap_ms);
+        }
+        _apply_gap(step.command, static_cast<uint16_t>(gap < 0xFFFF ? gap : 0xFFFF));
+
+        _calibration_next();
+    }
+
+
+
+    /**
+     * Moves a calibration run on to its next step, after the settle time
+     * (the player may still be answering probes).
+     **/
+    template <typename Transport>
+    void Driver<Transport>::_calibration_next()
+    {
+        _calibration.index++;
+        _calibration.round    = 0;
+        _calibration.worst_ms = 0;
+        _calibration.phase    = CalibrationPhase::SETTLING;
+        _calibration.ready_ms = _transport.now_ms() + CAL_SETTLE_MS;
+    }
+
+
+
+    /**
+     * Ends a calibration run: the queue resumes (after the track is played again if it was
+     * playing and no longer is) and the callback gets the result.
+     **/
+    template <typename Transport>
+    void Driver<Transport>::_calibration_finish()
+    {
+        _calibration.phase = CalibrationPhase::IDLE;
+
+        // Frames were sent behind the queue's back: nothing is awaiting an ACK
+        _awaiting_ack = false;
+
+        if (_show_debug_messages) {
+            _debug("Calibration %s.", _calibration.ok ? "done" : "incomplete");
+        }
+
+        // The status replies to the probes have updated the playback state
+        if (_calibration.restore.command != 0 && _state.playback != Playback::PLAYING) {
+            _send_command(_calibration.restore.command, _calibration.restore.data1, _calibration.restore.data2);
+        }
+
+        if (_calibration.callback) {
+            CalibrationCallback done = _calibration.callback;
+            _calibration.callback = nullptr;
+            done(_calibration.ok);
+        }
+    }
+
+
+
+    /**
+     * Writes a calibration frame, without requesting an ACK (so the only answer to a command is
+     * the reply to the next probe), and without touching the queue's pacing or pending queries.
+     * @param command The command byte.
+     * @param data1 The first data byte.
+     * @param data2 The second data byte.
+     **/
+    template <typename Transport>
+    void Driver<Transport>::_calibration_send(uint8_t command, uint8_t data1, uint8_t data2)
+    {
+        const frame::Frame frame = frame::make(command, data1, data2, frame::NO_ACK);
+        _transport.write(frame.bytes, frame::SIZE);
+
+        if (_show_debug_messages) {
+            _print_hex("Sending: ", frame.bytes, frame::SIZE);
+        }
+    }
+
+
+
+    /**
+     * Sets the measured gap of a command and of the commands that change the same part of
+     * the state (see `_group_of()`), or of every query if it was measured on a query.
+     * @param command The command byte measured.
+     * @param gap_ms The gap (ms).
+     **/
+    template <typename Transport>
+    void Driver<Transport>::_apply_gap(uint8_t command, uint16_t gap_ms)
+    {
+        const CommandGroup group    = _group_of(command);
+        const Descriptor*  measured = descriptor(command);
+
+        for (const Descriptor& desc : op::TABLE) {
+            const bool same = desc.opcode == command
+                           || (group != CommandGroup::NONE && _group_of(desc.opcode) == group)
+                           || (measured != nullptr && measured -> expects_reply && desc.expects_reply);
+            if (same) {
+                set_gap(desc.opcode, gap_ms);
+            }
+        }
+    }
+
+
+
+
+    /**
+     * Runs the health monitor from `poll()`: probes the player when it has been quiet for an
+     * interval, or re-initializes it after it restarted. Only while nothing else is going on.
+     **/
+    template <typename Transport>
+    void Driver<Transport>::_check_health()
+    {
+        if (_health.health == Health::DISABLED || _monitor.probing || _tx_count != 0 || _in_flight.active) {
+            return;
+        }
+
+        const unsigned long now = _transport.now_ms();
+
+        if (_monitor.restarted) {
+            _monitor.restarted = false;
+            _health.restarts++;
+            if (_show_debug_messages) {
+                _debug("DFPlayerMini: Player restarted, restoring its state.");
+            }
+
+            // After an outage, the state was saved when the player went silent (a reset has cleared it since)
+            if (!_monitor.has_saved) {
+                _monitor.saved = _state;
+            }
+
+            // The queue is empty here: only an init sequence too long for it can fail (kept for the next restart)
+            _monitor.has_saved = !_reinitialize();
+            if (_monitor.has_saved && _show_debug_messages) {
+                _debug("DFPlayerMini: Init sequence does not fit in the transmit queue, state not restored.");
+            }
+            return;
+        }
+
+        if (static_cast<long>(now - _monitor.next_ms) < 0) {
+            return;
+        }
+
+        // Any frame (ACK, reply, event) is proof of life
+        if (_health.health == Health::OK && now - _monitor.heard_ms < _monitor.interval_ms) {
+            _monitor.next_ms = _monitor.heard_ms + _jittered_interval();
+            return;
+        }
+
+        _probe_health();
+    }
+
+
+
+    /**
+     * Sends a status query as a health probe.
+     **/
+    template <typename Transport>
+    void Driver<Transport>::_probe_health()
+    {
+        _monitor.probing = query(cmd::QRY_STATUS, [this](bool ok, uint16_t) {
+            _probe_answered(ok);
+        }, PROBE_WAIT_MS);
+
+        if (_monitor.probing) {
+            _health.probes++;
+        }
+    }
+
+
+
+    /**
+     * Moves the health monitor on after a probe: back to `OK`, or one step up the escalation.
+     * @param ok `true` if the player answered.
+     **/
+    template <typename Transport>
+    void Driver<Transport>::_probe_answered(bool ok)
+    {
+        const unsigned long now = _transport.now_ms();
+        _monitor.probing = false;
+
+        if (ok) {
+            // Not restarted (just deaf for a while): nothing to restore
+            if (!_monitor.restarted) {
+                _monitor.has_saved = false;
+            }
+
+            if (_health.misses != 0) {
+                const unsigned long outage = now - _health.silent_since_ms;
+                _health.last_outage_ms    = outage;
+                _health.longest_outage_ms = outage > _health.longest_outage_ms ? outage : _health.longest_outage_ms;
+                _health.recoveries++;
+                if (_show_debug_messages) {
+                    _debug("DFPlayerMini: Player back after %lu ms of silence.", outage);
+                }
+            }
+            _health.health   = Health::OK;
+            _health.misses   = 0;
+            _monitor.next_ms = now + _jittered_interval();
+            return;
+        }
+
+        if (_health.misses < UINT8_MAX) {
+            _health.misses++;
+        }
+
+        if (_health.misses == 1) {
+            _health.outages++;
+            _health.silent_since_ms = _monitor.heard_ms;
+            _monitor.saved          = _state;
+            _monitor.has_saved      = true;
+        }
+        if (_show_debug_messages) {
+            _debug("DFPlayerMini: No answer to health probe (%u in a row).", _health.misses);
+        }
+
+        switch (_health.misses)
+        {
+            case 1:
+                _health.health   = Health::RETRYING;
+                _monitor.next_ms = now;
+                break;
+
+            case 2:
+                _health.health   = Health::RESETTING;
+                reset();
+                _monitor.next_ms = now + REBOOT_MS;
+                break;
+
+            default:
+                // Re-init on odd misses, if it fits in the queue: otherwise reset, and the restart
+                // (`0x3F`) re-inits from an empty queue
+                _health.health   = Health::REINITIALIZING;
+                if (_health.misses % 2 == 0 || !_reinitialize()) {
+                    reset();
+                }
+                _monitor.next_ms = now + _jittered_interval();
+                break;
+        }
+    }
+
+
+
+    /**
+     * Queues the init sequence, then the volume, EQ and track (and its playback state) saved
+     * before the outage or restart.
+     * @return `false` if the transmit queue cannot hold all of it (nothing is queued).
+     **/
+    template <typename Transport>
+    bool Driver<Transport>::_reinitialize()
+    {
+        const State& saved = _monitor.saved;
+        const bool   track = saved.track != 0 && saved.playback != Playback::UNKNOWN;
+
+        const size_t needed = (_monitor.init != nullptr ? _monitor.init_count : 0)
+                            + (saved.volume != UNKNOWN) + (saved.eq != UNKNOWN)
+                            + (track ? (saved.playback == Playback::PLAYING ? 1 : 2) : 0);
+        if (needed > static_cast<size_t>(TX_QUEUE_SIZE - _tx_count)) {
+            return false;
+        }
+
+        if (_monitor.init != nullptr) {
+            run_batch(_monitor.init, _monitor.init_count);
+        }
+
+        if (saved.volume != UNKNOWN) {
+            set_volume(saved.volume);
+        }
+        if (saved.eq != UNKNOWN) {
+            set_EQ(saved.eq);
+        }
+        if (track) {
+            if (saved.looping) {
+                loop_track(saved.track);
+            } else {
+                play_track(saved.track);
+            }
+
+            if (saved.playback == Playback::PAUSED) {
+                pause();
+            } else if (saved.playback == Playback::STOPPED) {
+                stop_all_playback();
+            }
+        }
+        return true;
+    }
+
+
+
+    /**
+     * Returns the probe interval with ±25% jitter.
+     * @return The time until the next check (ms).
+     **/
+    template <typename Transport>
+    unsigned long Driver<Transport>::_jittered_interval()
+    {
+        uint32_t x = _monitor.seed;
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        _monitor.seed = x;
+
+        const unsigned long spread = _monitor.interval_ms / 2;
+        return _monitor.interval_ms - spread / 2 + (spread != 0 ? x % (spread + 1) : 0);
+    }
+
+
+
+
+    /**
+     * Sends a `0x4C` poll when one is due and the link is idle (health probes go first).
+     **/
+    template <typename Transport>
+    void Driver<Transport>::_check_track()
+    {
+        if (_track_watch.min_ms == 0 || _track_watch.polling || _monitor.probing || _scan.active ||
+            _tx_count != 0 || _in_flight.active) {
+            return;
+        }
+
+        if (_health.health != Health::DISABLED && _health.health != Health::OK) {
+            return;
+        }
+
+        // Nothing changes while stopped or paused
+        if (_now_playing.confirmed && _state.playback != Playback::PLAYING && !_track_watch.status_due) {
+            return;
+        }
+
+        if (static_cast<long>(_transport.now_ms() - _track_watch.next_ms) < 0) {
+            return;
+        }
+
+        const uint16_t expected = _state.track;
+        _track_watch.polling = query(cmd::QRY_TRACK_SD_CARD, [this, expected](bool ok, uint16_t value) {
+            _track_reported(ok, value, expected);
+        });
+
+        if (!_track_watch.polling) {
+            return;
+        }
+        _track_watch.superseded = false;
+        _now_playing.polls++;
+
+        if (_track_watch.status_due) {
+            _track_watch.status_due = false;
+            query(cmd::QRY_STATUS, nullptr);
+        }
+    }
+
+
+
+    /**
+     * Marks the current track as unconfirmed and polls again soon.
+     **/
+    template <typename Transport>
+    void Driver<Transport>::_track_changed()
+    {
+        const unsigned long now = _transport.now_ms();
+
+        _now_playing.confirmed   = false;
+        _now_playing.changed_ms  = now;
+        _now_playing.interval_ms = _track_watch.min_ms;
+        _track_watch.next_ms     = now + _track_watch.min_ms;
+
+        if (_track_watch.polling) {
+            _track_watch.superseded = true;
+        }
+    }
+
+
+
+    /**
+     * Handles the reply to a `0x4C` poll: backs off while the track stays the same, starts over
+     * when it changed behind our back (the shadow state is already updated).
+     * @param ok The player answered.
+     * @param track The track it reported.
+     * @param expected The track the driver expected when the poll was sent.
+     **/
+    template <typename Transport>
+    void Driver<Transport>::_track_reported(bool ok, uint16_t track, uint16_t expected)
+    {
+        _track_watch.polling = false;
+
+        // Sent before one of our track commands: the next poll is already scheduled
+        if (_track_watch.superseded) {
+            _track_watch.superseded = false;
+            return;
+        }
+
+        const unsigned long now = _transport.now_ms();
+
+        if (ok) {
+            if (track != expected) {
+                if (expected != 0) {
+                    _now_playing.corrections++;
+                    if (_show_debug_messages) {
+                        _debug("DFPlayerMini: Now playing track %u (expected %u).", track, expected);
+                    }
+                }
+                _now_playing.changed_ms  = now;
+                _now_playing.interval_ms = _track_watch.min_ms;
+            }
+            else {
+                const unsigned long doubled = _now_playing.interval_ms * 2;
+                _now_playing.interval_ms = doubled < _track_watch.max_ms ? doubled : _track_watch.max_ms;
+            }
+            _now_playing.confirmed    = true;
+            _now_playing.confirmed_ms = now;
+        }
+
+        _track_watch.next_ms = now + _now_playing.interval_ms;
+    }
+
+
+
+
+    /**
+     * Continues a catalog scan once both counts are in: keeps the catalog if the card is the same,
+     * otherwise starts on the folders.
+     **/
+    template <typename Transport>
+    void Driver<Transport>::_scan_counted()
+    {
+        if (!_scan.ok) {
+            _scan_finish(false);
+            return;
+        }
+
+        _scan.result.fingerprint = catalog_fingerprint(_scan.result.total_tracks, _scan.result.folder_count);
+
+        if (_scan.result.fingerprint == _catalog.fingerprint) {
+            if (_show_debug_messages) {
+                _debug("DFPlayerMini: Same card (%u tracks, %u folders), catalog kept.",
+                       _scan.result.total_tracks, _scan.result.folder_count);
+            }
+            _scan_finish(false);
+            return;
+        }
+
+        if (_show_debug_messages) {
+            _debug("DFPlayerMini: New card (%u tracks, %u folders), scanning folders...",
+                   _scan.result.total_tracks, _scan.result.folder_count);
+        }
+        _scan_folders();
+    }
+
+
+
+    /**
+     * Keeps up to `SCAN_WINDOW` folder queries in flight, and finishes the scan after the last reply.
+     * Called again from each reply.
+     **/
+    template <typename Transport>
+    void Driver<Transport>::_scan_folders()
+    {
+        while (_scan.ok && _scan.in_flight < SCAN_WINDOW && _scan.next_folder <= _scan.result.folder_count) {
+            const uint8_t folder = _scan.next_folder;
+
+            const bool queued = query(cmd::QUERY_FLDR_TRACKS, folder, [this, folder](bool ok, uint16_t value) {
+                _scan.in_flight--;
+                _scan.ok = _scan.ok && ok;
+                _scan.result.folder_tracks[folder - 1] = static_cast<uint8_t>(value < 0xFF ? value : 0xFF);
+                _scan_folders();
+            });
+
+            if (!queued) {
+                // Out of query slots: carry on when one of ours comes back
+                if (_scan.in_flight == 0) {
+                    _scan.ok = false;
+                }
+                break;
+            }
+
+            _scan.next_folder++;
+            _scan.in_flight++;
+        }
+
+        if (_scan.in_flight != 0) {
+            return;
+        }
+
+        // A missed reply shifts the others (they are matched in order): keep the old catalog
+        if (!_scan.ok) {
+            _scan_finish(false);
+            return;
+        }
+
+        _catalog = _scan.result;
+        _scan_finish(true);
+    }
+
+
+
+    /**
+     * Ends a catalog scan and reports the result.
+     * @param changed The catalog was replaced.
+     **/
+    template <typename Transport>
+    void Driver<Transport>::_scan_finish(bool changed)
+    {
+        _scan.active = false;
+
+        if (!_scan.ok) {
+            if (_show_debug_messages) {
+                _debug("DFPlayerMini: Catalog scan failed (no reply).");
+            }
+        }
+
+        if (_scan.callback) {
+            CatalogCallback done = _scan.callback;
+            _scan.callback = nullptr;
+            done(_scan.ok, changed);
+        }
+    }
+}
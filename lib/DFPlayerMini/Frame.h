@@ -0,0 +1,117 @@
+/****************************************************************************************
+*                                                                                       *
+*   Frame.h - Frame encoder for TD5580A-based DFPlayer Mini clones                      *
+*                                                                                       *
+*   Written by Matt Kaufman, December, 2025.                                            *
+*                                                                                       *
+*   See:                                                                                *
+*     1. http://www.tudasemi.com/static/upload/file/20240905/1725499313437991.pdf       *
+*                                                                                       *
+*****************************************************************************************/
+
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include "Commands.h"
+
+
+namespace dfplayer::frame
+{
+    // Frame Structure HEAD  VER  LEN  CMD ACK DATA1 DATA2 CKH CKL  END
+    // Frame Structure 0x7E 0xFF 0x06  CMD ACK  D1    D2   CKH CKL 0xEF
+    constexpr uint8_t HEAD    = 0x7E;  // Start byte
+    constexpr uint8_t VERSION = 0xFF;  // Version byte
+    constexpr uint8_t LENGTH  = 0x06;  // Bytes from VER to DATA2 (inclusive)
+    constexpr uint8_t END     = 0xEF;  // End byte
+    constexpr size_t  SIZE    = 10;    // Full frame size, including checksum
+
+    constexpr uint8_t NO_ACK  = 0x00;  // No feedback requested
+    constexpr uint8_t ACK     = 0x01;  // Feedback (`0x41`) requested
+
+
+    /**
+     * A complete, checksummed frame, ready to be written in one go.
+     **/
+    struct Frame {
+        uint8_t bytes[SIZE];
+    };
+
+
+    /**
+     * Computes the frame checksum: `0 - (VER + LEN + CMD + ACK + DATA1 + DATA2)`.
+     * @return The 16-bit checksum (sent high byte first).
+     **/
+    constexpr uint16_t checksum(uint8_t command, uint8_t ack, uint8_t data1, uint8_t data2)
+    {
+        return static_cast<uint16_t>(0 - (VERSION + LENGTH + command + ack + data1 + data2));
+    }
+
+
+    /**
+     * Builds a frame. Usable at compile time (see the precomputed frames below).
+     * @param command The command byte.
+     * @param data1 The first data byte - default: `0`.
+     * @param data2 The second data byte - default: `0`.
+     * @param ack The feedback byte (`NO_ACK` / `ACK`) - default: `NO_ACK`.
+     **/
+    constexpr Frame make(uint8_t command, uint8_t data1 = 0, uint8_t data2 = 0, uint8_t ack = NO_ACK)
+    {
+        return Frame{{
+            HEAD,
+            VERSION,
+            LENGTH,
+            command,
+            ack,
+            data1,
+            data2,
+            static_cast<uint8_t>(checksum(command, ack, data1, data2) >> 8),
+            static_cast<uint8_t>(checksum(command, ack, data1, data2) & 0xFF),
+            END
+        }};
+    }
+
+
+    // Precomputed frames for commands that never carry data (stored in flash)
+    constexpr Frame NEXT         = make(cmd::NEXT);
+    constexpr Frame PREVIOUS     = make(cmd::PREVIOUS);
+    constexpr Frame VOL_UP       = make(cmd::VOL_UP);
+    constexpr Frame VOL_DOWN     = make(cmd::VOL_DOWN);
+    constexpr Frame SLEEP_MODE   = make(cmd::SLEEP_MODE);
+    constexpr Frame WAKE_UP      = make(cmd::WAKE_UP);
+    constexpr Frame RESET        = make(cmd::RESET);
+    constexpr Frame PLAY         = make(cmd::PLAY);
+    constexpr Frame PAUSE        = make(cmd::PAUSE);
+    constexpr Frame PLAY_LOOPS   = make(cmd::PLAY_LOOPS);
+    constexpr Frame STOP_ADVERTS = make(cmd::STOP_ADVERTS);
+    constexpr Frame STOP_PLAY    = make(cmd::STOP_PLAY);
+    constexpr Frame PLAY_SHUFFLE = make(cmd::PLAY_SHUFFLE);
+
+    static_assert(NEXT.bytes[7] == 0xFE && NEXT.bytes[8] == 0xFA, "Checksum of NEXT must be 0xFEFA");
+
+
+    /**
+     * Looks up the precomputed frame for a data-less command.
+     * @param command The command byte.
+     * @return Pointer to the frame in flash, or `nullptr` if the command has none.
+     **/
+    inline const Frame* fixed(uint8_t command)
+    {
+        switch (command)
+        {
+            case cmd::NEXT:         return &NEXT;
+            case cmd::PREVIOUS:     return &PREVIOUS;
+            case cmd::VOL_UP:       return &VOL_UP;
+            case cmd::VOL_DOWN:     return &VOL_DOWN;
+            case cmd::SLEEP_MODE:   return &SLEEP_MODE;
+            case cmd::WAKE_UP:      return &WAKE_UP;
+            case cmd::RESET:        return &RESET;
+            case cmd::PLAY:         return &PLAY;
+            case cmd::PAUSE:        return &PAUSE;
+            case cmd::PLAY_LOOPS:   return &PLAY_LOOPS;
+            case cmd::STOP_ADVERTS: return &STOP_ADVERTS;
+            case cmd::STOP_PLAY:    return &STOP_PLAY;
+            case cmd::PLAY_SHUFFLE: return &PLAY_SHUFFLE;
+            default:                return nullptr;
+        }
+    }
+}
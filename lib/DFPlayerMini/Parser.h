@@ -0,0 +1,178 @@
+/****************************************************************************************
+*                                                                                       *
+*   Parser.h - Streaming response parser for TD5580A-based DFPlayer Mini clones         *
+*                                                                                       *
+*   Written by Matt Kaufman, December, 2025.                                            *
+*                                                                                       *
+*   See:                                                                                *
+*     1. http://www.tudasemi.com/static/upload/file/20240905/1725499313437991.pdf       *
+*                                                                                       *
+*****************************************************************************************/
+
+#pragma once
+#include <stdint.h>
+#include <string.h>
+#include <atomic>
+#include "Frame.h"
+
+
+namespace dfplayer
+{
+    /**
+     * A decoded frame received from the player.
+     * `cmd` is the response/event code (`0x3A`..`0x4F`), `param` is DATA1:DATA2.
+     **/
+    struct Response {
+        uint8_t  cmd;
+        uint16_t param;
+    };
+
+
+    /**
+     * Incremental, allocation-free frame parser.
+     *
+     * Bytes are fed one at a time with `feed()`. Every completed frame is checked
+     * (version, length, checksum, end byte) and pushed into a small ring of `Response`s,
+     * so several back-to-back frames in one read never overwrite each other.
+     * On a bad byte the parser realigns on the next `0x7E` already received, so
+     * a good frame following garbage is not lost.
+     *
+     * The ring is single-producer/single-consumer: `feed()` may run in a UART event
+     * task while `pop()` runs in the main loop.
+     **/
+    class Parser {
+    public:
+        static constexpr uint8_t RING_SIZE = 8;  // Decoded responses kept until `pop()` (power of 2)
+
+        // Position of the next expected byte within a frame
+        enum class State : uint8_t {
+            HEAD, VER, LEN, CMD, ACK, DATA1, DATA2, CHK_HIGH, CHK_LOW, END
+        };
+
+        /**
+         * Feeds one received byte to the parser.
+         * @param b The received byte.
+         * @return `true` if the byte completed a valid frame.
+         **/
+        bool feed(uint8_t b)
+        {
+            _buf[_len++] = b;
+
+            while (_checked < _len) {
+                if (_valid_at(_checked)) {
+                    _checked++;
+                    continue;
+                }
+
+                // Bad byte: drop the frame start and realign on the next HEAD we already have
+                _errors++;
+                uint8_t skip = 1;
+                while (skip < _len && _buf[skip] != frame::HEAD) {
+                    skip++;
+                }
+                _discarded += skip;
+                memmove(_buf, _buf + skip, _len - skip);
+                _len    -= skip;
+                _checked = 0;
+            }
+
+            if (_len < frame::SIZE) {
+                return false;
+            }
+
+            _push({ _buf[3], static_cast<uint16_t>((_buf[5] << 8) | _buf[6]) });
+            _len     = 0;
+            _checked = 0;
+            _frames++;
+            return true;
+        }
+
+        /**
+         * Takes the oldest decoded response out of the ring.
+         * @param out Receives the response.
+         * @return `false` if no response is waiting.
+         **/
+        bool pop(Response& out)
+        {
+            const uint8_t tail = _ring_tail.load(std::memory_order_relaxed);
+            if (tail == _ring_head.load(std::memory_order_acquire)) {
+                return false;
+            }
+            out = _ring[tail];
+            _ring_tail.store((tail + 1) & (RING_SIZE - 1), std::memory_order_release);
+            return true;
+        }
+
+        /**
+         * Checks whether a decoded response is waiting (consumer side).
+         * @return `true` if `pop()` would return one.
+         **/
+        bool has_response() const
+        {
+            return _ring_tail.load(std::memory_order_relaxed) != _ring_head.load(std::memory_order_acquire);
+        }
+
+        /**
+         * Drops any partial frame and every decoded response.
+         **/
+        void reset()
+        {
+            _len     = 0;
+            _checked = 0;
+            _ring_tail.store(_ring_head.load(std::memory_order_acquire), std::memory_order_release);
+        }
+
+        State    state()     const { return static_cast<State>(_len); }  // Next expected byte
+        uint32_t frames()    const { return _frames; }     // Valid frames decoded
+        uint32_t errors()    const { return _errors; }     // Framing/checksum errors
+        uint32_t discarded() const { return _discarded; }  // Bytes thrown away while realigning
+        uint32_t overflows() const { return _overflows; }  // Responses lost because the ring was full
+
+    private:
+        uint8_t  _buf[frame::SIZE];   // Bytes of the frame being received
+        uint8_t  _len     = 0;        // Bytes in `_buf`
+        uint8_t  _checked = 0;        // Bytes in `_buf` already validated
+
+        Response             _ring[RING_SIZE];
+        std::atomic<uint8_t> _ring_head{0};  // Written by the producer (`feed()`)
+        std::atomic<uint8_t> _ring_tail{0};  // Written by the consumer (`pop()`)
+
+        uint32_t _frames    = 0;
+        uint32_t _errors    = 0;
+        uint32_t _discarded = 0;
+        uint32_t _overflows = 0;
+
+        // Checks the byte at `pos`, given that every byte before it is valid
+        bool _valid_at(uint8_t pos) const
+        {
+            const uint8_t b = _buf[pos];
+
+            switch (static_cast<State>(pos))
+            {
+                case State::HEAD:     return b == frame::HEAD;
+                case State::VER:      return b == frame::VERSION;
+                case State::LEN:      return b == frame::LENGTH;
+                case State::CMD:      return true;
+                case State::ACK:      return b == frame::NO_ACK || b == frame::ACK;
+                case State::DATA1:    return true;
+                case State::DATA2:    return true;
+                case State::CHK_HIGH: return true;
+                case State::CHK_LOW:  return ((_buf[7] << 8) | b) == frame::checksum(_buf[3], _buf[4], _buf[5], _buf[6]);
+                case State::END:      return b == frame::END;
+            }
+            return false;
+        }
+
+        void _push(const Response& r)
+        {
+            const uint8_t head = _ring_head.load(std::memory_order_relaxed);
+            const uint8_t next = (head + 1) & (RING_SIZE - 1);
+            if (next == _ring_tail.load(std::memory_order_acquire)) {
+                _overflows++;
+                return;
+            }
+            _ring[head] = r;
+            _ring_head.store(next, std::memory_order_release);
+        }
+    };
+}
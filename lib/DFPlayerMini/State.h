@@ -0,0 +1,170 @@
+/****************************************************************************************
+*                                                                                       *
+*   State.h - Shadow of the state of TD5580A-based DFPlayer Mini clones                 *
+*                                                                                       *
+*   Written by Matt Kaufman, December, 2025.                                            *
+*                                                                                       *
+*****************************************************************************************/
+
+#pragma once
+#include <stdint.h>
+#include "Commands.h"
+#include "Parser.h"
+
+
+namespace dfplayer
+{
+    constexpr uint8_t UNKNOWN = 0xFF;  // Value of a `uint8_t` field not known yet
+
+
+    enum class Playback : uint8_t {
+        UNKNOWN,
+        STOPPED,
+        PLAYING,
+        PAUSED
+    };
+
+
+    /**
+     * Everything the driver knows about the player, kept up to date from the commands
+     * it sends and the frames it receives. Reading it never touches the UART.
+     **/
+    struct State {
+        uint8_t  volume             = UNKNOWN;            // 0-30
+        uint8_t  eq                 = UNKNOWN;            // 0-6
+        uint8_t  source             = UNKNOWN;            // 1-6 (see `set_source()`)
+        uint16_t track              = 0;                  // Current track (`0`: unknown)
+        bool     looping            = false;              // Current track loops
+        Playback playback           = Playback::UNKNOWN;
+        bool     card_online        = false;              // SD card inserted (as last reported)
+        uint16_t folder_count       = 0;                  // `0`: unknown
+        uint16_t folder_track_count = 0;                  // `0`: unknown
+        uint16_t total_track_count  = 0;                  // `0`: unknown
+
+
+        /**
+         * Updates the state with the expected effect of a command sent to the player.
+         * @param command The command byte.
+         * @param data1 The first data byte.
+         * @param data2 The second data byte.
+         **/
+        void apply_command(uint8_t command, uint8_t data1, uint8_t data2)
+        {
+            const uint16_t data = (data1 << 8) | data2;
+
+            switch (command)
+            {
+                case cmd::SET_VOL:     volume = data2;  break;
+                case cmd::SET_EQ:      eq     = data2;  break;
+                case cmd::SET_SOURCE:  source = data2;  break;
+
+                case cmd::VOL_UP:
+                    if (volume < 30) volume++;
+                    break;
+
+                case cmd::VOL_DOWN:
+                    if (volume != UNKNOWN && volume > 0) volume--;
+                    break;
+
+                case cmd::PLAY_N:
+                    track    = data;
+                    looping  = false;
+                    playback = Playback::PLAYING;
+                    break;
+
+                case cmd::PLAY_S_LOOP:
+                    // DATA1 is the folder in the two-argument form (`LoopTrackInFolder`): the
+                    // track number on the card is then unknown, as for `PLAY_F_FILE`
+                    track    = data1 == 0 ? data2 : 0;
+                    looping  = true;
+                    playback = Playback::PLAYING;
+                    break;
+
+                case cmd::NEXT:
+                case cmd::PREVIOUS:
+                    // Wraps around when the track count is known, otherwise becomes unknown at the ends
+                    if (track != 0 && command == cmd::NEXT) {
+                        track = (total_track_count != 0 && track >= total_track_count) ? 1 : track + 1;
+                    }
+                    else if (track != 0) {
+                        track = (track > 1) ? track - 1 : total_track_count;
+                    }
+                    playback = Playback::PLAYING;
+                    break;
+
+                case cmd::PLAY_F_FILE:
+                case cmd::PLAY_LOOPS:
+                case cmd::FOLDER_CYCLE:
+                case cmd::PLAY_SHUFFLE:
+                    track    = 0;
+                    looping  = false;
+                    playback = Playback::PLAYING;
+                    break;
+
+                case cmd::SET_SPLAY:  looping  = (data2 == 1);         break;
+                case cmd::PLAY:       playback = Playback::PLAYING;    break;
+                case cmd::PAUSE:      playback = Playback::PAUSED;     break;
+                case cmd::STOP_PLAY:  playback = Playback::STOPPED;    break;
+
+                case cmd::RESET:
+                    *this = State();
+                    break;
+            }
+        }
+
+
+        /**
+         * Updates the state from a frame received from the player (query reply or event).
+         * @param response The decoded frame.
+         **/
+        void apply_response(const Response& response)
+        {
+            const uint8_t low = response.param & 0xFF;
+
+            switch (response.cmd)
+            {
+                case cmd::QU_DEV_INSERTED:
+                    card_online        = true;
+                    folder_count       = 0;
+                    folder_track_count = 0;
+                    total_track_count  = 0;
+                    break;
+
+                case cmd::QU_DEV_UNPLUGGED:
+                    card_online        = false;
+                    track              = 0;
+                    playback           = Playback::STOPPED;
+                    folder_count       = 0;
+                    folder_track_count = 0;
+                    total_track_count  = 0;
+                    break;
+
+                case cmd::QU_TF_SD_COMPL:
+                    track = response.param;
+                    if (!looping) {
+                        playback = Playback::STOPPED;
+                    }
+                    break;
+
+                case cmd::SEND_INIT_PARAMS:
+                    card_online = (low & cmd::STS_SD_CARD_ONLINE) != 0;
+                    break;
+
+                case cmd::QRY_STATUS:
+                    switch (low) {
+                        case 0: playback = Playback::STOPPED; break;
+                        case 1: playback = Playback::PLAYING; break;
+                        case 2: playback = Playback::PAUSED;  break;
+                    }
+                    break;
+
+                case cmd::QRY_VOLUME:           volume             = low;             break;
+                case cmd::QRY_EQUALIZATION:     eq                 = low;             break;
+                case cmd::QRY_TOTAL_FILES_TFC:  total_track_count  = response.param;  break;
+                case cmd::QRY_TRACK_SD_CARD:    track              = response.param;  break;
+                case cmd::QUERY_FLDR_TRACKS:    folder_track_count = response.param;  break;
+                case cmd::QUERY_FLDR_COUNT:     folder_count       = response.param;  break;
+            }
+        }
+    };
+}
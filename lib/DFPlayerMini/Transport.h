@@ -0,0 +1,50 @@
+/****************************************************************************************
+*                                                                                       *
+*   Transport.h - Arduino transports for the DFPlayer Mini driver (see `Driver.h`)      *
+*                                                                                       *
+*   Written by Matt Kaufman, December, 2025.                                            *
+*                                                                                       *
+*****************************************************************************************/
+
+#pragma once
+#include <Arduino.h>
+
+
+namespace dfplayer
+{
+    /**
+     * Hardware UART transport. The calls are qualified with `HardwareSerial::`, so they are
+     * bound at compile time instead of going through the `Stream` vtable.
+     **/
+    class HardwareSerialTransport {
+    public:
+        explicit HardwareSerialTransport(HardwareSerial& serial) : _serial(serial) {}
+
+        size_t        write(const uint8_t* buf, size_t len) { return _serial.HardwareSerial::write(buf, len); }
+        int           available()                           { return _serial.HardwareSerial::available(); }
+        int           read()                                { return _serial.HardwareSerial::read(); }
+        unsigned long now_ms()                              { return millis(); }
+        void          debug(const char* line)               { Serial.println(line); }
+
+    private:
+        HardwareSerial& _serial;
+    };
+
+
+    /**
+     * Transport for any other `Stream` (SoftwareSerial, USB CDC, ...), through its virtual methods.
+     **/
+    class StreamTransport {
+    public:
+        explicit StreamTransport(Stream& stream) : _stream(stream) {}
+
+        size_t        write(const uint8_t* buf, size_t len) { return _stream.write(buf, len); }
+        int           available()                           { return _stream.available(); }
+        int           read()                                { return _stream.read(); }
+        unsigned long now_ms()                              { return millis(); }
+        void          debug(const char* line)               { Serial.println(line); }
+
+    private:
+        Stream& _stream;
+    };
+}
@@ -0,0 +1,103 @@
+/****************************************************************************************
+*                                                                                       *
+*   Mailbox.h - Bounded lock-free multi-producer, single-consumer queue                 *
+*                                                                                       *
+*   Written by Matt Kaufman, December, 2025.                                            *
+*                                                                                       *
+*   See:                                                                                *
+*     1. https://www.1024cores.net/home/lock-free-algorithms/queues/bounded-mpmc-queue  *
+*                                                                                       *
+*****************************************************************************************/
+
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+
+
+/**
+ * Fixed ring of `N` records that any number of tasks may `push()` to and one task `pop()`s
+ * from, without locks: a producer claims a slot with one compare-and-swap on the tail, and
+ * each slot carries a sequence number telling whether it is free, written, or read (see: 1).
+ * Nothing is allocated after construction; a full mailbox rejects the record.
+ * `T` is copied in and out, so keep it small and trivially copyable.
+ **/
+template <typename T, size_t N>
+class Mailbox {
+    static_assert(N >= 2 && (N & (N - 1)) == 0, "Mailbox size must be a power of two");
+
+public:
+    Mailbox()
+    {
+        for (size_t i = 0; i < N; i++) {
+            _cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    Mailbox(const Mailbox&) = delete;
+    Mailbox& operator=(const Mailbox&) = delete;
+
+
+    /**
+     * Adds a record (any task).
+     * @param value The record.
+     * @return `false` if the mailbox is full.
+     **/
+    bool push(const T& value)
+    {
+        size_t position = _tail.load(std::memory_order_relaxed);
+
+        for (;;) {
+            Cell& cell = _cells[position & (N - 1)];
+            const size_t   sequence = cell.sequence.load(std::memory_order_acquire);
+            const intptr_t distance = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position);
+
+            if (distance == 0) {
+                // Slot is free: claim it (another producer may get there first)
+                if (_tail.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                    cell.value = value;
+                    cell.sequence.store(position + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (distance < 0) {
+                // Slot still holds a record from the previous lap: full
+                return false;
+            }
+            else {
+                position = _tail.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+
+    /**
+     * Takes the oldest record (the consumer task only).
+     * @param value Receives the record.
+     * @return `false` if the mailbox is empty.
+     **/
+    bool pop(T& value)
+    {
+        Cell& cell = _cells[_head & (N - 1)];
+        const size_t sequence = cell.sequence.load(std::memory_order_acquire);
+
+        if (sequence != _head + 1) {
+            return false;
+        }
+
+        value = cell.value;
+        cell.sequence.store(_head + N, std::memory_order_release);
+        _head++;
+        return true;
+    }
+
+private:
+    struct Cell {
+        std::atomic<size_t> sequence;  // `position`: free, `position + 1`: written, `position + N`: read
+        T                   value;
+    };
+
+    Cell                _cells[N];
+    std::atomic<size_t> _tail{0};      // Next position to write (producers)
+    size_t              _head = 0;     // Next position to read (consumer only)
+};
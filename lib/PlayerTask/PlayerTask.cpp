@@ -0,0 +1,260 @@
+/****************************************************************************************
+*                                                                                       *
+*   PlayerTask.cpp - FreeRTOS task that owns the DFPlayer Mini                          *
+*                                                                                       *
+*   Written by Matt Kaufman, December, 2025.                                            *
+*                                                                                       *
+*****************************************************************************************/
+
+#include "PlayerTask.h"
+#include <string.h>
+
+
+using namespace dfplayer;
+
+
+
+/**
+ * Constructor for `PlayerTask` class.
+ * @param player The player, set up (`begin()` etc.) before `start()` and not used directly after.
+ **/
+PlayerTask::PlayerTask(DFPlayerMini& player) : _player(player) {}
+
+
+
+/**
+ * Starts the task. From now on, only the task calls the player.
+ * @return `false` if the task could not be created (or is already running).
+ **/
+bool PlayerTask::start()
+{
+    if (_task != nullptr) {
+        return false;
+    }
+
+    _publish();
+    if (xTaskCreate(_run, "player", STACK_SIZE, this, PRIORITY, &_task) != pdPASS) {
+        _task = nullptr;
+        return false;
+    }
+
+    // Replies and events wake the task too
+    _player.notify_on_receive(_task);
+    return true;
+}
+
+
+
+/**
+ * Hands a command to the player task (any task, never blocks).
+ * @param op The command.
+ * @param arg Its argument, if any (see `Op`).
+ * @return The id its completion will carry, `0` if the mailbox is full.
+ **/
+uint32_t PlayerTask::submit(Op op, int16_t arg)
+{
+    uint32_t id = _next_id.fetch_add(1, std::memory_order_relaxed);
+    if (id == 0) {
+        id = _next_id.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    if (!_mailbox.push({ id, op, arg })) {
+        return 0;
+    }
+
+    // Wake the task now rather than at its next poll
+    if (_task != nullptr) {
+        xTaskNotifyGive(_task);
+    }
+    return id;
+}
+
+
+
+/**
+ * Takes the outcome of the oldest completed command (one consumer task only).
+ * @param completion Receives the outcome.
+ * @return `false` if there is none.
+ **/
+bool PlayerTask::next_completion(Completion& completion)
+{
+    return _completions.pop(completion);
+}
+
+
+
+/**
+ * Returns a copy of what the player task knows (any task).
+ * @return The snapshot, as of the last poll.
+ **/
+PlayerTask::Snapshot PlayerTask::snapshot()
+{
+    std::lock_guard<std::mutex> lock(_snapshot_mutex);
+    return _snapshot;
+}
+
+
+
+/**
+ * Returns the name of a command, for logs.
+ * @param op The command.
+ * @return The name.
+ **/
+const char* PlayerTask::op_name(Op op)
+{
+    switch (op)
+    {
+        case Op::LOOP_TRACK:   return "loop_track";
+        case Op::NEXT:         return "next";
+        case Op::PREVIOUS:     return "previous";
+        case Op::PAUSE:        return "pause";
+        case Op::RESUME:       return "resume";
+        case Op::STOP:         return "stop";
+        case Op::VOLUME_UP:    return "volume_up";
+        case Op::VOLUME_DOWN:  return "volume_down";
+        case Op::SET_EQ:       return "set_eq";
+        case Op::START_REPEAT: return "start_repeat";
+        case Op::STOP_REPEAT:  return "stop_repeat";
+        case Op::CALIBRATE:    return "calibrate";
+    }
+    return "?";
+}
+
+
+
+/**
+ * Task body: sends the commands in the mailbox, polls the player, publishes the snapshot if
+ * anything changed, then sleeps until a command or bytes arrive or the driver's next deadline.
+ * @param self The `PlayerTask`.
+ **/
+void PlayerTask::_run(void* self)
+{
+    PlayerTask& task = *static_cast<PlayerTask*>(self);
+
+    for (;;) {
+        bool executed = false;
+        Command command;
+        while (task._mailbox.pop(command)) {
+            task._execute(command);
+            executed = true;
+        }
+
+        task._player.poll();
+
+        if (executed || task._changed()) {
+            task._publish();
+        }
+
+        // At least one tick: a deadline that is already due must not keep this task from yielding
+        const unsigned long wait_ms = task._player.next_poll_in(MAX_SLEEP_MS);
+        const TickType_t    ticks   = pdMS_TO_TICKS(wait_ms);
+        ulTaskNotifyTake(pdTRUE, ticks > 0 ? ticks : 1);
+    }
+}
+
+
+
+/**
+ * Hands one command to the driver and reports whether it was taken.
+ * @param command The command record.
+ **/
+void PlayerTask::_execute(const Command& command)
+{
+    bool ok = false;
+
+    switch (command.op)
+    {
+        case Op::LOOP_TRACK:   ok = _player.send<op::LoopTrack>(command.arg);  break;
+        case Op::NEXT:         ok = _player.send<op::Next>();                  break;
+        case Op::PREVIOUS:     ok = _player.send<op::Previous>();              break;
+        case Op::PAUSE:        ok = _player.send<op::Pause>();                 break;
+        case Op::RESUME:       ok = _player.send<op::Play>();                  break;
+        case Op::STOP:         ok = _player.send<op::Stop>();                  break;
+        case Op::VOLUME_UP:    ok = _player.send<op::VolumeUp>();              break;
+        case Op::VOLUME_DOWN:  ok = _player.send<op::VolumeDown>();            break;
+        case Op::SET_EQ:       ok = _player.send<op::SetEQ>(command.arg);      break;
+        case Op::START_REPEAT: ok = _player.send<op::LoopCurrent>(arg<1>);     break;
+        case Op::STOP_REPEAT:  ok = _player.send<op::LoopCurrent>(arg<0>);     break;
+
+        case Op::CALIBRATE:
+            // Completes when the run is over
+            if (_player.calibrate([this, command](bool measured) { _complete(command.id, command.op, measured); })) {
+                return;
+            }
+            break;
+    }
+
+    _complete(command.id, command.op, ok);
+}
+
+
+
+/**
+ * Posts the outcome of a command (dropped if nobody is reading them).
+ **/
+void PlayerTask::_complete(uint32_t id, Op op, bool ok)
+{
+    _completions.push({ id, op, ok });
+}
+
+
+
+/**
+ * Checks whether the driver differs from the last snapshot (read by the task only: no lock).
+ * @return `true` if it should be published again.
+ **/
+bool PlayerTask::_changed() const
+{
+    const State& state = _player.get_state();
+    const State& last  = _snapshot.state;
+    if (state.volume != last.volume || state.eq != last.eq || state.source != last.source ||
+        state.track != last.track || state.looping != last.looping || state.playback != last.playback ||
+        state.card_online != last.card_online || state.folder_count != last.folder_count ||
+        state.folder_track_count != last.folder_track_count || state.total_track_count != last.total_track_count) {
+        return true;
+    }
+
+    const HealthStats& health = _player.get_health();
+    const HealthStats& last_health = _snapshot.health;
+    if (health.health != last_health.health || health.misses != last_health.misses ||
+        health.probes != last_health.probes || health.outages != last_health.outages ||
+        health.recoveries != last_health.recoveries || health.restarts != last_health.restarts ||
+        health.silent_since_ms != last_health.silent_since_ms || health.last_outage_ms != last_health.last_outage_ms ||
+        health.longest_outage_ms != last_health.longest_outage_ms) {
+        return true;
+    }
+
+    const NowPlaying& now_playing = _player.get_now_playing();
+    const NowPlaying& last_now_playing = _snapshot.now_playing;
+    if (now_playing.confirmed != last_now_playing.confirmed || now_playing.changed_ms != last_now_playing.changed_ms ||
+        now_playing.confirmed_ms != last_now_playing.confirmed_ms || now_playing.interval_ms != last_now_playing.interval_ms ||
+        now_playing.polls != last_now_playing.polls || now_playing.corrections != last_now_playing.corrections) {
+        return true;
+    }
+
+    const Catalog& catalog = _player.get_catalog();
+    const Catalog& last_catalog = _snapshot.catalog;
+    if (catalog.fingerprint != last_catalog.fingerprint || catalog.total_tracks != last_catalog.total_tracks ||
+        catalog.folder_count != last_catalog.folder_count ||
+        memcmp(catalog.folder_tracks, last_catalog.folder_tracks, sizeof(catalog.folder_tracks)) != 0) {
+        return true;
+    }
+
+    return _player.is_detected() != _snapshot.detected || _player.is_calibrating() != _snapshot.calibrating;
+}
+
+
+
+/**
+ * Copies what the other tasks may read out of the driver.
+ **/
+void PlayerTask::_publish()
+{
+    std::lock_guard<std::mutex> lock(_snapshot_mutex);
+    _snapshot.state       = _player.get_state();
+    _snapshot.health      = _player.get_health();
+    _snapshot.now_playing = _player.get_now_playing();
+    _snapshot.catalog     = _player.get_catalog();
+    _snapshot.detected    = _player.is_detected();
+    _snapshot.calibrating = _player.is_calibrating();
+}
@@ -0,0 +1,104 @@
+/****************************************************************************************
+*                                                                                       *
+*   PlayerTask.h - FreeRTOS task that owns the DFPlayer Mini                            *
+*                                                                                       *
+*   Written by Matt Kaufman, December, 2025.                                            *
+*                                                                                       *
+*****************************************************************************************/
+
+#ifndef PLAYER_TASK_H
+#define PLAYER_TASK_H
+
+#include <Arduino.h>
+#include <atomic>
+#include <mutex>
+#include <DFPlayerMini.h>
+#include "Mailbox.h"
+
+
+/**
+ * Runs `DFPlayerMini` in a task of its own: nothing else calls it once `start()` has been
+ * called. Other tasks (HTTP handlers, timers, ...) `submit()` command records to a lock-free
+ * mailbox and return right away; the task sends them and polls the player, then publishes
+ * a snapshot of what it knows (`snapshot()`) when it changed. In between, it sleeps until
+ * the driver's next deadline, a command, or bytes from the player. The outcome of every
+ * command comes back on a completion channel (`next_completion()`).
+ **/
+class PlayerTask {
+public:
+    enum class Op : uint8_t {
+        LOOP_TRACK,     // `arg`: track
+        NEXT,
+        PREVIOUS,
+        PAUSE,
+        RESUME,
+        STOP,
+        VOLUME_UP,
+        VOLUME_DOWN,
+        SET_EQ,         // `arg`: EQ (see `set_EQ()`)
+        START_REPEAT,
+        STOP_REPEAT,
+        CALIBRATE
+    };
+
+    // A command record (see `submit()`)
+    struct Command {
+        uint32_t id;
+        Op       op;
+        int16_t  arg;
+    };
+
+    // The outcome of a command: `ok` if the player took it (queued for the UART; for
+    // `CALIBRATE`, once the run is over and every command was measured)
+    struct Completion {
+        uint32_t id;
+        Op       op;
+        bool     ok;
+    };
+
+    // Everything the other tasks may read, copied out of the driver after each poll
+    struct Snapshot {
+        dfplayer::State       state;
+        dfplayer::HealthStats health;
+        dfplayer::NowPlaying  now_playing;
+        dfplayer::Catalog     catalog;
+        bool                  detected    = false;
+        bool                  calibrating = false;
+    };
+
+    explicit PlayerTask(DFPlayerMini& player);
+
+    bool start();
+
+    uint32_t submit(Op op, int16_t arg = 0);
+    bool     next_completion(Completion& completion);
+    Snapshot snapshot();
+
+    static const char* op_name(Op op);
+
+private:
+    static constexpr size_t        MAILBOX_SIZE     = 32;    // Commands waiting for the task
+    static constexpr size_t        COMPLETIONS_SIZE = 32;    // Outcomes waiting for the consumer
+    static constexpr uint32_t      STACK_SIZE       = 6144;  // Task stack (bytes)
+    static constexpr UBaseType_t   PRIORITY         = 2;     // Above the Arduino loop (1)
+    static constexpr unsigned long MAX_SLEEP_MS     = 1000;  // Longest sleep with nothing due
+
+    DFPlayerMini&  _player;                  // Owned by the task once started
+    TaskHandle_t   _task = nullptr;
+
+    Mailbox<Command, MAILBOX_SIZE>        _mailbox;      // Producers: any task; consumer: the player task
+    Mailbox<Completion, COMPLETIONS_SIZE> _completions;  // Producer: the player task; consumer: one task
+    std::atomic<uint32_t>                 _next_id{1};
+
+    std::mutex _snapshot_mutex;              // Held while `_snapshot` is copied (written by the task only)
+    Snapshot   _snapshot;
+
+    static void _run(void* self);
+    void        _execute(const Command& command);
+    void        _complete(uint32_t id, Op op, bool ok);
+    bool        _changed() const;
+    void        _publish();
+};
+
+
+#endif  // PLAYER_TASK_H
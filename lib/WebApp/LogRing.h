@@ -0,0 +1,92 @@
+/****************************************************************************************
+*                                                                                       *
+*   LogRing.h - Fixed ring of numbered log lines for the web terminal                   *
+*                                                                                       *
+*   Written by Matt Kaufman, December, 2025.                                            *
+*                                                                                       *
+*****************************************************************************************/
+
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+
+/**
+ * The last `LINES` log lines, each numbered (1, 2, ...) and truncated to `LINE_SIZE - 1`
+ * characters. All storage is part of the object: appending copies into the oldest slot and
+ * never allocates. Readers keep their own cursor (the number of the last line they got), so
+ * any number of them each see every line still in the ring.
+ * Not thread-safe: callers serialize `append()` and `read()`.
+ **/
+template <size_t LINES, size_t LINE_SIZE>
+class LogRing {
+    static_assert(LINES >= 1 && LINE_SIZE >= 2 && LINE_SIZE <= 256, "LogRing: bad size");
+
+public:
+    // Where a reader stands after `read()`
+    struct Cursor {
+        uint32_t next;      // Pass back as `since` next time
+        uint32_t dropped;   // Lines overwritten before this reader got them
+    };
+
+
+    /**
+     * Adds a line (truncated to `LINE_SIZE - 1` characters).
+     * @param text The line, without the trailing newline.
+     * @return Its number.
+     **/
+    uint32_t append(const char* text)
+    {
+        Line& line = _lines[_next % LINES];
+        size_t length = strnlen(text, LINE_SIZE - 1);
+        memcpy(line.text, text, length);
+        line.text[length] = '\0';
+        line.length = static_cast<uint8_t>(length);
+        return _next++;
+    }
+
+
+    /**
+     * Hands every line newer than `since` to `emit(number, text, length)`, oldest first.
+     * A cursor ahead of the ring (the device restarted) reads from the oldest line.
+     * @param since The number of the last line the reader got (`0`: none yet).
+     * @param emit Called once per line.
+     * @return The reader's new cursor.
+     **/
+    template <typename F>
+    Cursor read(uint32_t since, F&& emit) const
+    {
+        const uint32_t newest = _next - 1;
+        const uint32_t oldest = _next > LINES ? _next - LINES : 1;
+
+        uint32_t from = since > newest ? oldest : since + 1;
+
+        Cursor cursor = { newest, 0 };
+        if (from < oldest) {
+            cursor.dropped = oldest - from;
+            from = oldest;
+        }
+
+        for (uint32_t n = from; n <= newest; n++) {
+            const Line& line = _lines[n % LINES];
+            emit(n, line.text, static_cast<size_t>(line.length));
+        }
+        return cursor;
+    }
+
+
+    /**
+     * @return The number of the newest line (`0` if none).
+     **/
+    uint32_t newest() const { return _next - 1; }
+
+private:
+    struct Line {
+        uint8_t length;
+        char    text[LINE_SIZE];
+    };
+
+    Line     _lines[LINES] = {};
+    uint32_t _next = 1;         // Number of the next line appended
+};
@@ -10,10 +10,10 @@
 #include "WebApp.h"
 
 #include <Arduino.h>
+#include <stdarg.h>
 #include <WiFi.h>
 #include <ESPmDNS.h>
 #include <SPIFFS.h>
-#include <DFPlayerMini.h>
 
 
 namespace webserver
@@ -24,11 +24,87 @@ namespace webserver
 }
 
 
+/**
+ * Returns the JSON name of a playback state.
+ */
+static const char* playback_name(dfplayer::Playback playback)
+{
+    switch (playback) {
+        case dfplayer::Playback::STOPPED: return "stopped";
+        case dfplayer::Playback::PLAYING: return "playing";
+        case dfplayer::Playback::PAUSED:  return "paused";
+        default:                          return "unknown";
+    }
+}
+
+
+/**
+ * Formats a `uint8_t` state field (`null` if unknown).
+ */
+static const char* format_u8(char* buf, size_t len, uint8_t value)
+{
+    if (value == dfplayer::UNKNOWN) {
+        snprintf(buf, len, "null");
+    } else {
+        snprintf(buf, len, "%u", value);
+    }
+    return buf;
+}
+
+
+/**
+ * Formats the age of the last time the player confirmed the track (`null` if it has not
+ * since the last change).
+ */
+static const char* format_confirmed(char* buf, size_t len, const dfplayer::NowPlaying& now_playing)
+{
+    if (now_playing.confirmed) {
+        snprintf(buf, len, "%lu", millis() - now_playing.confirmed_ms);
+    } else {
+        snprintf(buf, len, "null");
+    }
+    return buf;
+}
+
+
+/**
+ * Finds `"key":` in a flat JSON object (compact `/ws` messages only: keys are not
+ * looked for inside strings).
+ * @return The value, spaces skipped; `nullptr` if there is no such key.
+ */
+static const char* json_value(const char* json, const char* key)
+{
+    char quoted[16];
+    snprintf(quoted, sizeof(quoted), "\"%s\"", key);
+
+    const char* found = strstr(json, quoted);
+    if (found == nullptr) {
+        return nullptr;
+    }
+    found += strlen(quoted);
+    while (*found == ' ') found++;
+    if (*found++ != ':') {
+        return nullptr;
+    }
+    while (*found == ' ') found++;
+    return found;
+}
+
+
+/**
+ * Checks a request argument against a command's range (as the driver would clamp it).
+ * @return `true` if the driver would send it unchanged.
+ */
+static bool in_range(long value, const dfplayer::Range& range)
+{
+    return value >= range.low && value <= range.high;
+}
+
+
 
 WebApp::WebApp(
-    DFPlayerMini& player,
-    String& log_buffer
-) : _server(webserver::port), _player(player), _log_buffer(log_buffer) { }
+    PlayerTask& player
+) : _server(webserver::port), _events("/events"), _ws("/ws"), _player(player) { }
 
 
 void WebApp::begin()
@@ -42,44 +118,365 @@ void WebApp::begin()
 }
 
 
-void WebApp::handle_client()
+void WebApp::log()
 {
-    _server.handleClient();
+    std::lock_guard<std::mutex> lock(_log_mutex);
+    _log.append("");
 }
 
 
-void WebApp::log()
+void WebApp::log(const char* msg)
 {
-    _log_buffer += "\n";
+    logf("%s", msg);
+}
 
-    // Prevent memory overflow
-    if (_log_buffer.length() > 2000) { 
-        _log_buffer = _log_buffer.substring(_log_buffer.length() - 1000); 
-    }
+
+void WebApp::log(const String& msg)
+{
+    logf("%s", msg.c_str());
 }
 
 
-void WebApp::log(String msg)
+void WebApp::logf(const char* format, ...)
 {
     unsigned long ms = millis();
     unsigned long sec = ms / 1000;
     unsigned long rem = ms % 1000;
 
-    // Create formatted timestamp string
+    // Timestamp, then the message, straight into one line on the stack
     // %lu   = unsigned long
     // %03lu = unsigned long, at least 3 digits, zero-padded (e.g. 5 -> 005)
-    char time_str[20];
-    snprintf(time_str, sizeof(time_str), "[%lu.%03lu]", sec, rem);
+    char line[LOG_LINE_SIZE];
+    int length = snprintf(line, sizeof(line), "[%lu.%03lu] >> ", sec, rem);
 
-    // Combine with the message
-    String timestamped_msg = String(time_str) + " >> " + msg;
+    va_list args;
+    va_start(args, format);
+    vsnprintf(line + length, sizeof(line) - length, format, args);
+    va_end(args);
+
+    // Called from the main loop, the player task and request handlers
+    std::lock_guard<std::mutex> lock(_log_mutex);
+    _log.append(line);
+}
+
+
+void WebApp::update()
+{
+    _ws.cleanupClients();
+
+    // Commands whose completion never came (dropped with the completion channel full): answered
+    // and freed, or the slots would run out and every command be refused as busy
+    const unsigned long now_ms = millis();
+    for (;;) {
+        PendingAck expired;
+        {
+            std::lock_guard<std::mutex> lock(_acks_mutex);
+            for (PendingAck& slot : _acks) {
+                if (slot.command != 0 && now_ms - slot.sent_ms >= WS_TIMEOUT_MS) {
+                    expired = slot;
+                    slot.command = 0;
+                    break;
+                }
+            }
+        }
+        if (expired.command == 0) {
+            break;
+        }
+        logf("Socket #%lu: id %lu not completed, given up", static_cast<unsigned long>(expired.client), static_cast<unsigned long>(expired.id));
+        ack(expired.client, expired.id, false, "timeout");
+    }
+
+    // Nobody listening: skip ahead (a new client gets the backlog on connect)
+    if (_events.count() == 0 && _ws.count() == 0) {
+        std::lock_guard<std::mutex> lock(_log_mutex);
+        _pushed.log = _log.newest();
+        _pushed.valid = false;
+        return;
+    }
+
+    // New log lines, numbered so that a reconnecting client resumes after the last one it got.
+    // One at a time: the log lock is not held while sending.
+    char line[LOG_LINE_SIZE];
+    for (;;) {
+        uint32_t number = 0;
+        {
+            std::lock_guard<std::mutex> lock(_log_mutex);
+            _log.read(_pushed.log, [&](uint32_t n, const char* text, size_t length) {
+                if (number == 0) {
+                    number = n;
+                    memcpy(line, text, length);
+                    line[length] = '\0';
+                }
+            });
+        }
+        if (number == 0) {
+            break;
+        }
+        _events.send(line, "log", number);
+        _pushed.log = number;
+    }
+
+    // Player state and health, when they changed
+    const PlayerTask::Snapshot snapshot = _player.snapshot();
+    const dfplayer::State& state = snapshot.state;
+    const dfplayer::HealthStats& health = snapshot.health;
+
+    const bool state_changed = !_pushed.valid
+        || state.playback != _pushed.state.playback
+        || state.volume != _pushed.state.volume
+        || state.eq != _pushed.state.eq
+        || state.source != _pushed.state.source
+        || state.track != _pushed.state.track
+        || state.looping != _pushed.state.looping
+        || state.card_online != _pushed.state.card_online
+        || state.folder_count != _pushed.state.folder_count
+        || state.total_track_count != _pushed.state.total_track_count
+        || snapshot.now_playing.confirmed != _pushed.confirmed;
+
+    const bool health_changed = !_pushed.valid
+        || health.health != _pushed.health
+        || snapshot.detected != _pushed.detected
+        || health.outages != _pushed.outages
+        || health.recoveries != _pushed.recoveries
+        || health.restarts != _pushed.restarts;
+
+    char json[320];
+    if (state_changed) {
+        format_state(json, sizeof(json), snapshot);
+        _events.send(json, "state");
+        format_state_delta(json, sizeof(json), snapshot);
+        _ws.textAll(json);
+        _pushed.state = state;
+        _pushed.confirmed = snapshot.now_playing.confirmed;
+    }
+    if (health_changed) {
+        format_health(json, sizeof(json), snapshot);
+        _events.send(json, "health");
+        char message[sizeof(json) + 16];
+        snprintf(message, sizeof(message), "{\"health\":%s}", json);
+        _ws.textAll(message);
+        _pushed.health = health.health;
+        _pushed.detected = snapshot.detected;
+        _pushed.outages = health.outages;
+        _pushed.recoveries = health.recoveries;
+        _pushed.restarts = health.restarts;
+    }
+    _pushed.valid = true;
+}
+
+
+void WebApp::handle_events_connect(AsyncEventSourceClient* client)
+{
+    // Already on the broadcast list: a line may arrive twice (the page skips numbers it has seen)
+    const uint32_t since = client->lastId();
+    char number[12];
+
+    // Newest line first (lower than the page's cursor: the device restarted), then the lines missed
+    std::unique_lock<std::mutex> lock(_log_mutex);
+    const LogRing<LOG_LINES, LOG_LINE_SIZE>::Cursor cursor = _log.read(since, [](uint32_t, const char*, size_t) {});
+    snprintf(number, sizeof(number), "%lu", static_cast<unsigned long>(cursor.next));
+    client->send(number, "cursor");
+    if (cursor.dropped > 0) {
+        snprintf(number, sizeof(number), "%lu", static_cast<unsigned long>(cursor.dropped));
+        client->send(number, "dropped");
+    }
+    _log.read(since, [client](uint32_t n, const char* text, size_t) {
+        client->send(text, "log", n);
+    });
+    lock.unlock();
+
+    const PlayerTask::Snapshot snapshot = _player.snapshot();
+    char json[320];
+    format_state(json, sizeof(json), snapshot);
+    client->send(json, "state");
+    format_health(json, sizeof(json), snapshot);
+    client->send(json, "health");
+}
+
+
+void WebApp::handle_ws_event(AsyncWebSocketClient* client, AwsEventType type, void* arg, uint8_t* data, size_t len)
+{
+    if (type == WS_EVT_CONNECT) {
+        // Everything, as a first delta
+        const PlayerTask::Snapshot snapshot = _player.snapshot();
+        char json[320];
+        char message[sizeof(json) + 16];
+        format_state(json, sizeof(json), snapshot);
+        snprintf(message, sizeof(message), "{\"state\":%s}", json);
+        client->text(message);
+        format_health(json, sizeof(json), snapshot);
+        snprintf(message, sizeof(message), "{\"health\":%s}", json);
+        client->text(message);
+        return;
+    }
+
+    if (type == WS_EVT_DISCONNECT) {
+        // Nobody left to acknowledge: free its slots
+        std::lock_guard<std::mutex> lock(_acks_mutex);
+        for (PendingAck& slot : _acks) {
+            if (slot.command != 0 && slot.client == client->id()) {
+                slot.command = 0;
+            }
+        }
+        return;
+    }
+
+    if (type != WS_EVT_DATA) {
+        return;
+    }
+
+    // Commands are small: one unfragmented text frame each
+    const AwsFrameInfo* info = static_cast<AwsFrameInfo*>(arg);
+    if (!info->final || info->index != 0 || info->len != len || info->opcode != WS_TEXT) {
+        return;
+    }
+    if (len >= WS_MESSAGE_SIZE) {
+        client->text("{\"id\":null,\"ok\":false,\"error\":\"too long\"}");
+        return;
+    }
+
+    char message[WS_MESSAGE_SIZE];
+    memcpy(message, data, len);
+    message[len] = '\0';
+    handle_ws_command(client, message);
+}
+
+
+void WebApp::handle_ws_command(AsyncWebSocketClient* client, const char* message)
+{
+    _metrics.ws_messages++;
+
+    const char* id_value = json_value(message, "id");
+    if (id_value == nullptr || *id_value < '0' || *id_value > '9') {
+        client->text("{\"id\":null,\"ok\":false,\"error\":\"missing id\"}");
+        return;
+    }
+    const uint32_t id = strtoul(id_value, nullptr, 10);
+
+    // `op`: the name of a `PlayerTask::Op`
+    char name[16] = "";
+    const char* op_value = json_value(message, "op");
+    if (op_value != nullptr && *op_value == '"') {
+        const char* end = strchr(++op_value, '"');
+        if (end != nullptr && static_cast<size_t>(end - op_value) < sizeof(name)) {
+            memcpy(name, op_value, end - op_value);
+            name[end - op_value] = '\0';
+        }
+    }
+
+    bool found = false;
+    PlayerTask::Op op = PlayerTask::Op::NEXT;
+    for (uint8_t i = 0; i <= static_cast<uint8_t>(PlayerTask::Op::CALIBRATE); i++) {
+        if (strcmp(name, PlayerTask::op_name(static_cast<PlayerTask::Op>(i))) == 0) {
+            op = static_cast<PlayerTask::Op>(i);
+            found = true;
+            break;
+        }
+    }
+    if (!found) {
+        ack(client->id(), id, false, "unknown op");
+        return;
+    }
+
+    // `args`: `[n]` or `n`
+    long arg = 0;
+    const char* args_value = json_value(message, "args");
+    if (args_value != nullptr) {
+        if (*args_value == '[') args_value++;
+        arg = strtol(args_value, nullptr, 10);
+    }
+
+    logf("Socket #%lu: %s(%ld), id %lu", static_cast<unsigned long>(client->id()), name, arg, static_cast<unsigned long>(id));
+
+    // Ranges from the command table (what the driver would clamp), as `/play` checks them
+    const PlayerTask::Snapshot snapshot = _player.snapshot();
+    const char* error = nullptr;
+    switch (op) {
+        case PlayerTask::Op::LOOP_TRACK:
+            if (!in_range(arg, dfplayer::op::LoopTrack::desc.args[0])) {
+                error = "invalid track";
+            } else if (snapshot.catalog.fingerprint != 0 && arg > snapshot.catalog.total_tracks) {
+                error = "no such track";
+            }
+            break;
+        case PlayerTask::Op::SET_EQ:
+            if (!in_range(arg, dfplayer::op::SetEQ::desc.args[0])) {
+                error = "invalid eq";
+            }
+            break;
+        case PlayerTask::Op::CALIBRATE:
+            if (snapshot.calibrating) {
+                error = "calibration in progress";
+            }
+            break;
+        default:
+            break;
+    }
+    if (error != nullptr) {
+        ack(client->id(), id, false, error);
+        return;
+    }
+
+    // Recorded before the player task can complete it (completions are drained under the same lock)
+    {
+        std::lock_guard<std::mutex> lock(_acks_mutex);
+        PendingAck* slot = nullptr;
+        for (PendingAck& candidate : _acks) {
+            if (candidate.command == 0) {
+                slot = &candidate;
+                break;
+            }
+        }
+
+        const uint32_t command = slot != nullptr ? _player.submit(op, static_cast<int16_t>(arg)) : 0;
+        if (command != 0) {
+            *slot = { command, client->id(), id, millis() };
+            return;
+        }
+    }
+
+    log("DFPlayer busy, socket command dropped");
+    ack(client->id(), id, false, "busy");
+}
+
+
+void WebApp::ack(uint32_t client, uint32_t id, bool ok, const char* error)
+{
+    char json[64];
+    if (ok) {
+        snprintf(json, sizeof(json), "{\"id\":%lu,\"ok\":true}", static_cast<unsigned long>(id));
+    } else {
+        snprintf(json, sizeof(json), "{\"id\":%lu,\"ok\":false,\"error\":\"%s\"}", static_cast<unsigned long>(id), error);
+    }
+    _ws.text(client, json);
+}
+
+
+void WebApp::handle_completion(const PlayerTask::Completion& completion)
+{
+    // Submitted over `/ws`: acknowledge it
+    PendingAck pending;
+    {
+        std::lock_guard<std::mutex> lock(_acks_mutex);
+        for (PendingAck& slot : _acks) {
+            if (slot.command == completion.id) {
+                pending = slot;
+                slot.command = 0;
+                break;
+            }
+        }
+    }
+    if (pending.command != 0) {
+        ack(pending.client, pending.id, completion.ok, completion.ok ? nullptr : "dropped");
+    }
 
-    // Append to web buffer
-    _log_buffer += timestamped_msg + "\n";
+    if (completion.op == PlayerTask::Op::CALIBRATE) {
+        logf("Calibration %s (gaps saved to NVS)", completion.ok ? "done" : "incomplete");
+        return;
+    }
 
-    // Prevent memory overflow
-    if (_log_buffer.length() > 2000) { 
-        _log_buffer = _log_buffer.substring(_log_buffer.length() - 1000); 
+    if (!completion.ok) {
+        logf("DFPlayer: Command %s #%lu dropped", PlayerTask::op_name(completion.op), static_cast<unsigned long>(completion.id));
     }
 }
 
@@ -104,6 +501,40 @@ bool WebApp::setup_mdns()
 
 void WebApp::setup_routes()
 {
+    // Dynamic endpoints (matched before the static files: a static handler on `/` matches any path)
+    route("/log", &WebApp::handle_log);
+    route("/play", &WebApp::handle_play);
+    route("/status", &WebApp::handle_status);
+    route("/health", &WebApp::handle_health);
+    route("/state", &WebApp::handle_state);
+    route("/api/tracks", &WebApp::handle_tracks);
+    route("/calibrate", &WebApp::handle_calibrate);
+    route("/api/metrics", &WebApp::handle_metrics);
+
+    // Server-Sent Events: log lines, state and health as they change (see `update()`)
+    _events.onConnect([this](AsyncEventSourceClient* client) { handle_events_connect(client); });
+    _server.addHandler(&_events);
+
+    // WebSocket: commands with acknowledgements, state changes (see `handle_ws_command()`)
+    _ws.onEvent([this](AsyncWebSocket*, AsyncWebSocketClient* client, AwsEventType type, void* arg, uint8_t* data, size_t len) {
+        handle_ws_event(client, type, arg, data, len);
+    });
+    _server.addHandler(&_ws);
+    
+    // Playback controls
+    route("/previous", &WebApp::handle_previous);
+    route("/pause", &WebApp::handle_pause);
+    route("/resume", &WebApp::handle_resume);
+    route("/next", &WebApp::handle_next);
+    route("/volume_down", &WebApp::handle_volume_down);
+    route("/stop", &WebApp::handle_stop);
+    route("/volume_up", &WebApp::handle_volume_up);
+    route("/start_repeat", &WebApp::handle_start_repeat);
+    route("/stop_repeat", &WebApp::handle_stop_repeat);
+    route("/set_eq_normal", &WebApp::handle_set_EQ_normal);
+    route("/set_eq_rock", &WebApp::handle_set_EQ_rock);
+    route("/set_eq_pop", &WebApp::handle_set_EQ_pop);
+
     // Serve static files
     _server.serveStatic("/", SPIFFS, "/index.html");
 
@@ -112,191 +543,433 @@ void WebApp::setup_routes()
     _server.serveStatic("/manifest.json", SPIFFS, "/manifest.json");
     _server.serveStatic("/apple-touch-icon.png", SPIFFS, "/icon.svg");
 
-    // Dynamic endpoints
-    _server.on("/log", HTTP_GET, [this]() { handle_log(); });
-    _server.on("/play", HTTP_GET, [this]() { handle_play(); });
-    _server.on("/status", HTTP_GET, [this]() { handle_status(); });
-    
-    // Playback controls
-    _server.on("/previous", HTTP_GET, [this]() { handle_previous(); });
-    _server.on("/pause", HTTP_GET, [this]() { handle_pause(); });
-    _server.on("/resume", HTTP_GET, [this]() { handle_resume(); });
-    _server.on("/next", HTTP_GET, [this]() { handle_next(); });
-    _server.on("/volume_down", HTTP_GET, [this]() { handle_volume_down(); });
-    _server.on("/stop", HTTP_GET, [this]() { handle_stop(); });
-    _server.on("/volume_up", HTTP_GET, [this]() { handle_volume_up(); });
-    _server.on("/start_repeat", HTTP_GET, [this]() { handle_start_repeat(); });
-    _server.on("/stop_repeat", HTTP_GET, [this]() { handle_stop_repeat(); });
-    _server.on("/set_eq_normal", HTTP_GET, [this]() { handle_set_EQ_normal(); });
-    _server.on("/set_eq_rock", HTTP_GET, [this]() { handle_set_EQ_rock(); });
-    _server.on("/set_eq_pop", HTTP_GET, [this]() { handle_set_EQ_pop(); });
-
     // 404 handler
-    _server.onNotFound([this]() { handle_not_found(); });
+    _server.onNotFound([this](AsyncWebServerRequest* request) { handle_not_found(request); });
+}
+
+
+void WebApp::route(const char* uri, void (WebApp::*handler)(AsyncWebServerRequest*))
+{
+    _server.on(uri, HTTP_GET, [this, handler](AsyncWebServerRequest* request) {
+        const unsigned long start = micros();
+        (this->*handler)(request);
+        record(micros() - start);
+    });
+}
+
+
+void WebApp::record(unsigned long elapsed_us)
+{
+    _metrics.requests++;
+
+    uint8_t bucket = 0;
+    while (bucket < LATENCY_BUCKETS - 1 && (elapsed_us >> (bucket + 1)) != 0) {
+        bucket++;
+    }
+    _metrics.latency[bucket]++;
+
+    if (elapsed_us > _metrics.max_us) {
+        _metrics.max_us = elapsed_us;
+    }
+
+    // Requests per second over fixed windows
+    const unsigned long now = millis();
+    _metrics.window_requests++;
+    if (now - _metrics.window_start_ms >= RATE_WINDOW_MS) {
+        _metrics.requests_per_s  = _metrics.window_requests * 1000.0f / (now - _metrics.window_start_ms);
+        _metrics.window_start_ms = now;
+        _metrics.window_requests = 0;
+    }
+}
+
+
+void WebApp::submit(AsyncWebServerRequest* request, PlayerTask::Op op, int16_t arg, const String& body)
+{
+    const uint32_t id = _player.submit(op, arg);
+
+    if (id == 0) {
+        logf("DFPlayer mailbox full, %s dropped", PlayerTask::op_name(op));
+        request->send(503, "text/plain", "Player busy");
+        return;
+    }
+
+    logf("Queued DFPlayer %s #%lu", PlayerTask::op_name(op), static_cast<unsigned long>(id));
+    request->send(202, "text/plain", body);
 }
 
 
-void WebApp::handle_log()
+unsigned long WebApp::latency_percentile(float p) const
 {
-    _server.send(200, "text/plain", _log_buffer);
-    _log_buffer = "";
+    uint32_t total = 0;
+    for (uint32_t count : _metrics.latency) {
+        total += count;
+    }
+
+    uint32_t seen = 0;
+    for (uint8_t bucket = 0; bucket < LATENCY_BUCKETS; bucket++) {
+        seen += _metrics.latency[bucket];
+        if (total != 0 && seen * 100.0f >= total * p) {
+            return 2UL << bucket;
+        }
+    }
+    return 0;
 }
 
 
-void WebApp::handle_not_found()
+void WebApp::handle_log(AsyncWebServerRequest* request)
 {
-   _server.send(404, "text/plain", "Not found");
+    // Each reader keeps its own cursor: nothing is consumed
+    uint32_t since = 0;
+    if (request->hasParam("since")) {
+        since = strtoul(request->getParam("since")->value().c_str(), nullptr, 10);
+    }
+
+    AsyncResponseStream* response = request->beginResponseStream("text/plain");
+
+    LogRing<LOG_LINES, LOG_LINE_SIZE>::Cursor cursor;
+    {
+        std::lock_guard<std::mutex> lock(_log_mutex);
+        cursor = _log.read(since, [response](uint32_t, const char* text, size_t length) {
+            response->write(reinterpret_cast<const uint8_t*>(text), length);
+            response->write('\n');
+        });
+    }
+
+    response->addHeader("X-Log-Next", String(cursor.next));
+    response->addHeader("X-Log-Dropped", String(cursor.dropped));
+    response->addHeader("Cache-Control", "no-store");
+    request->send(response);
+}
+
+
+void WebApp::handle_not_found(AsyncWebServerRequest* request)
+{
+   _metrics.not_found++;
+   request->send(404, "text/plain", "Not found");
 }
 
 
-void WebApp::handle_play()
+void WebApp::handle_play(AsyncWebServerRequest* request)
 {
-    if (!_server.hasArg("track")) {
-        _server.send(400, "text/plain", "Missing 'track'");
+    if (!request->hasParam("track")) {
+        request->send(400, "text/plain", "Missing 'track'");
         return;
     }
 
-    int track = _server.arg("track").toInt();
+    int track = request->getParam("track")->value().toInt();
 
     log();
     log("Received call to /play endpoint with track=" + String(track));
 
-    if (track <= 0) {
+    if (!in_range(track, dfplayer::op::LoopTrack::desc.args[0])) {
         log("Invalid track number received: " + String(track));
-        _server.send(400, "text/plain", "Invalid track number.");
+        request->send(400, "text/plain", "Invalid track number.");
         return;
     }
 
-    _player.loop_track(track);
-    log("Called DFPlayer.loop_track(track)");
+    // Only checked once the card has been indexed
+    const PlayerTask::Snapshot snapshot = _player.snapshot();
+    const dfplayer::Catalog& catalog = snapshot.catalog;
+    if (catalog.fingerprint != 0 && track > catalog.total_tracks) {
+        log("Track " + String(track) + " not on the card (" + String(catalog.total_tracks) + " tracks)");
+        request->send(404, "text/plain", "No such track.");
+        return;
+    }
 
-    _server.send(200, "text/plain", "Looping track " + String(track));
+    submit(request, PlayerTask::Op::LOOP_TRACK, track, "Looping track " + String(track));
 }
 
 
-void WebApp::handle_status()
+bool WebApp::is_online(const PlayerTask::Snapshot& snapshot)
 {
-    log();
-    log("Received call to /status endpoint");
-    _server.send(200, "text/plain", "1");
+    const dfplayer::HealthStats& health = snapshot.health;
+    const bool answering = health.health == dfplayer::Health::DISABLED
+                        || health.health == dfplayer::Health::OK
+                        || health.health == dfplayer::Health::RETRYING;
+    return answering && (snapshot.detected || health.recoveries > 0);
 }
 
 
-void WebApp::handle_previous()
+void WebApp::handle_status(AsyncWebServerRequest* request)
+{
+    // Polled by the page: not logged
+    request->send(200, "text/plain", is_online(_player.snapshot()) ? "1" : "0");
+}
+
+
+void WebApp::handle_health(AsyncWebServerRequest* request)
+{
+    char json[320];
+    format_health(json, sizeof(json), _player.snapshot());
+    request->send(200, "application/json", json);
+}
+
+
+void WebApp::format_health(char* json, size_t size, const PlayerTask::Snapshot& snapshot) const
+{
+    const dfplayer::HealthStats& health = snapshot.health;
+
+    const char* state = "disabled";
+    switch (health.health) {
+        case dfplayer::Health::OK:             state = "ok";             break;
+        case dfplayer::Health::RETRYING:       state = "retrying";       break;
+        case dfplayer::Health::RESETTING:      state = "resetting";      break;
+        case dfplayer::Health::REINITIALIZING: state = "reinitializing"; break;
+        default: break;
+    }
+
+    // Silence so far, while the player is not answering
+    const unsigned long silent_ms = health.misses != 0 ? millis() - health.silent_since_ms : 0;
+
+    snprintf(json, size,
+        "{\"health\":\"%s\",\"online\":%s,\"detected\":%s,\"misses\":%u,\"probes\":%lu,\"outages\":%lu,"
+        "\"recoveries\":%lu,\"restarts\":%lu,\"silent_ms\":%lu,\"last_outage_ms\":%lu,\"longest_outage_ms\":%lu}",
+        state,
+        is_online(snapshot) ? "true" : "false",
+        snapshot.detected ? "true" : "false",
+        health.misses,
+        static_cast<unsigned long>(health.probes),
+        static_cast<unsigned long>(health.outages),
+        static_cast<unsigned long>(health.recoveries),
+        static_cast<unsigned long>(health.restarts),
+        silent_ms,
+        health.last_outage_ms,
+        health.longest_outage_ms
+    );
+}
+
+
+void WebApp::handle_state(AsyncWebServerRequest* request)
+{
+    char json[320];
+    format_state(json, sizeof(json), _player.snapshot());
+    request->send(200, "application/json", json);
+}
+
+
+void WebApp::format_state(char* json, size_t size, const PlayerTask::Snapshot& snapshot) const
+{
+    const dfplayer::State& state = snapshot.state;
+
+    char volume[8], eq[8], source[8], confirmed[16];
+    snprintf(json, size,
+        "{\"playback\":\"%s\",\"volume\":%s,\"eq\":%s,\"source\":%s,\"track\":%u,\"track_confirmed_ms\":%s,"
+        "\"looping\":%s,\"card\":%s,\"folders\":%u,\"tracks\":%u}",
+        playback_name(state.playback),
+        format_u8(volume, sizeof(volume), state.volume),
+        format_u8(eq, sizeof(eq), state.eq),
+        format_u8(source, sizeof(source), state.source),
+        state.track,
+        format_confirmed(confirmed, sizeof(confirmed), snapshot.now_playing),
+        state.looping ? "true" : "false",
+        state.card_online ? "true" : "false",
+        state.folder_count,
+        state.total_track_count
+    );
+}
+
+
+void WebApp::format_state_delta(char* json, size_t size, const PlayerTask::Snapshot& snapshot) const
+{
+    const dfplayer::State& state = snapshot.state;
+    const dfplayer::State& last = _pushed.state;
+    const bool all = !_pushed.valid;
+
+    size_t length = snprintf(json, size, "{\"state\":{");
+    bool first = true;
+    auto field = [&](bool changed, const char* key, const char* value, bool quoted = false) {
+        if (!changed || length >= size) {
+            return;
+        }
+        const char* quote = quoted ? "\"" : "";
+        length += snprintf(json + length, size - length, "%s\"%s\":%s%s%s", first ? "" : ",", key, quote, value, quote);
+        first = false;
+    };
+
+    char value[16];
+    field(all || state.playback != last.playback, "playback", playback_name(state.playback), true);
+    field(all || state.volume != last.volume, "volume", format_u8(value, sizeof(value), state.volume));
+    field(all || state.eq != last.eq, "eq", format_u8(value, sizeof(value), state.eq));
+    field(all || state.source != last.source, "source", format_u8(value, sizeof(value), state.source));
+    snprintf(value, sizeof(value), "%u", state.track);
+    field(all || state.track != last.track, "track", value);
+    field(all || snapshot.now_playing.confirmed != _pushed.confirmed, "track_confirmed_ms",
+          format_confirmed(value, sizeof(value), snapshot.now_playing));
+    field(all || state.looping != last.looping, "looping", state.looping ? "true" : "false");
+    field(all || state.card_online != last.card_online, "card", state.card_online ? "true" : "false");
+    snprintf(value, sizeof(value), "%u", state.folder_count);
+    field(all || state.folder_count != last.folder_count, "folders", value);
+    snprintf(value, sizeof(value), "%u", state.total_track_count);
+    field(all || state.total_track_count != last.total_track_count, "tracks", value);
+
+    if (length < size) {
+        snprintf(json + length, size - length, "}}");
+    }
+}
+
+
+void WebApp::handle_tracks(AsyncWebServerRequest* request)
+{
+    const PlayerTask::Snapshot snapshot = _player.snapshot();
+    const dfplayer::Catalog& catalog = snapshot.catalog;
+
+    char etag[12];
+    snprintf(etag, sizeof(etag), "\"%08lx\"", static_cast<unsigned long>(catalog.fingerprint));
+
+    if (catalog.fingerprint != 0 && request->hasHeader("If-None-Match") && request->header("If-None-Match") == etag) {
+        AsyncWebServerResponse* response = request->beginResponse(304);
+        response->addHeader("ETag", etag);
+        response->addHeader("Cache-Control", "no-cache");
+        request->send(response);
+        return;
+    }
+
+    // Up to 99 folders of up to 3 digits
+    char json[512];
+    int len = snprintf(json, sizeof(json), "{\"total\":%u,\"folders\":[", catalog.total_tracks);
+    for (uint8_t i = 0; i < catalog.folder_count; i++) {
+        len += snprintf(json + len, sizeof(json) - len, i == 0 ? "%u" : ",%u", catalog.folder_tracks[i]);
+    }
+    snprintf(json + len, sizeof(json) - len, "]}");
+
+    AsyncWebServerResponse* response = request->beginResponse(200, "application/json", json);
+    response->addHeader("ETag", etag);
+    response->addHeader("Cache-Control", "no-cache");
+    request->send(response);
+}
+
+
+void WebApp::handle_previous(AsyncWebServerRequest* request)
 {
     log();
     log("Received call to /previous endpoint");
-    _player.play_previous();
-    log("Called DFPlayer.play_previous()");
-    _server.send(200, "text/plain", "OK");
+    submit(request, PlayerTask::Op::PREVIOUS);
 }
 
 
-void WebApp::handle_pause()
+void WebApp::handle_pause(AsyncWebServerRequest* request)
 {
     log();
     log("Received call to /pause endpoint");
-    _player.pause();
-    log("Called DFPlayer.pause()");
-    _server.send(200, "text/plain", "OK");
+    submit(request, PlayerTask::Op::PAUSE);
 }
 
 
-void WebApp::handle_resume()
+void WebApp::handle_resume(AsyncWebServerRequest* request)
 {
     log();
     log("Received call to /resume endpoint");
-    _player.play();
-    log("Called DFPlayer.play()");
-    _server.send(200, "text/plain", "OK");
+    submit(request, PlayerTask::Op::RESUME);
 }
 
 
-void WebApp::handle_next()
+void WebApp::handle_next(AsyncWebServerRequest* request)
 {
     log();
     log("Received call to /next endpoint");
-    _player.play_next();
-    log("Called DFPlayer.play_next()");
-    _server.send(200, "text/plain", "OK");
+    submit(request, PlayerTask::Op::NEXT);
 }
 
 
-void WebApp::handle_volume_down()
+void WebApp::handle_volume_down(AsyncWebServerRequest* request)
 {
     log();
     log("Received call to /volume_down endpoint");
-    _player.decrement_volume();
-    log("Called DFPlayer.decrement_volume()");
-    _server.send(200, "text/plain", "OK");
+    submit(request, PlayerTask::Op::VOLUME_DOWN);
 }
 
 
-void WebApp::handle_stop()
+void WebApp::handle_stop(AsyncWebServerRequest* request)
 {
     log();
     log("Received call to /stop endpoint");
-    _player.stop_all_playback();
-    log("Called DFPlayer.stop_all_playback()");
-    _server.send(200, "text/plain", "OK");
+    submit(request, PlayerTask::Op::STOP);
 }
 
 
-void WebApp::handle_volume_up()
+void WebApp::handle_volume_up(AsyncWebServerRequest* request)
 {
     log();
     log("Received call to /volume_up endpoint");
-    _player.increment_volume();
-    log("Called DFPlayer.increment_volume()");
-    _server.send(200, "text/plain", "OK");
+    submit(request, PlayerTask::Op::VOLUME_UP);
 }
 
 
-void WebApp::handle_start_repeat()
+void WebApp::handle_start_repeat(AsyncWebServerRequest* request)
 {
     log();
     log("Received call to /start_repeat endpoint");
-    _player.start_looping_current_track();
-    log("Called DFPlayer.start_looping_current_track()");
-    _server.send(200, "text/plain", "OK");
+    submit(request, PlayerTask::Op::START_REPEAT);
 }
 
 
-void WebApp::handle_stop_repeat()
+void WebApp::handle_stop_repeat(AsyncWebServerRequest* request)
 {
     log();
     log("Received call to /stop_repeat endpoint");
-    _player.stop_looping_current_track();
-    log("Called DFPlayer.stop_looping_current_track()");
-    _server.send(200, "text/plain", "OK");
+    submit(request, PlayerTask::Op::STOP_REPEAT);
 }
 
 
-void WebApp::handle_set_EQ_normal()
+void WebApp::handle_set_EQ_normal(AsyncWebServerRequest* request)
 {
     log();
     log("Received call to /set_eq_normal endpoint");
-    _player.set_EQ(0);
-    log("Called DFPlayer.set_EQ(0)");
-    _server.send(200, "text/plain", "OK");
+    submit(request, PlayerTask::Op::SET_EQ, 0);
 }
 
 
-void WebApp::handle_set_EQ_rock()
+void WebApp::handle_set_EQ_rock(AsyncWebServerRequest* request)
 {
     log();
     log("Received call to /set_eq_rock endpoint");
-    _player.set_EQ(1);
-    log("Called DFPlayer.set_EQ(1)");
-    _server.send(200, "text/plain", "OK");
+    submit(request, PlayerTask::Op::SET_EQ, 1);
 }
 
 
-void WebApp::handle_set_EQ_pop()
+void WebApp::handle_set_EQ_pop(AsyncWebServerRequest* request)
 {
     log();
     log("Received call to /set_eq_pop endpoint");
-    _player.set_EQ(3);
-    log("Called DFPlayer.set_EQ(3)");
-    _server.send(200, "text/plain", "OK");
-}
\ No newline at end of file
+    submit(request, PlayerTask::Op::SET_EQ, 3);
+}
+
+
+void WebApp::handle_calibrate(AsyncWebServerRequest* request)
+{
+    log();
+    log("Received call to /calibrate endpoint");
+
+    if (_player.snapshot().calibrating) {
+        log("Calibration already in progress");
+        request->send(409, "text/plain", "Calibration already in progress");
+        return;
+    }
+
+    // The end of the run comes back on the completion channel
+    submit(request, PlayerTask::Op::CALIBRATE, 0, "Calibrating");
+}
+
+
+void WebApp::handle_metrics(AsyncWebServerRequest* request)
+{
+    char json[256];
+    snprintf(json, sizeof(json),
+        "{\"requests\":%lu,\"not_found\":%lu,\"requests_per_s\":%.1f,\"handler_p50_us\":%lu,"
+        "\"handler_p99_us\":%lu,\"handler_max_us\":%lu,\"free_heap\":%lu,\"min_free_heap\":%lu,\"uptime_ms\":%lu,"
+        "\"ws_clients\":%lu,\"ws_messages\":%lu}",
+        static_cast<unsigned long>(_metrics.requests),
+        static_cast<unsigned long>(_metrics.not_found),
+        _metrics.requests_per_s,
+        latency_percentile(50),
+        latency_percentile(99),
+        _metrics.max_us,
+        static_cast<unsigned long>(ESP.getFreeHeap()),
+        static_cast<unsigned long>(ESP.getMinFreeHeap()),
+        millis(),
+        static_cast<unsigned long>(_ws.count()),
+        static_cast<unsigned long>(_metrics.ws_messages)
+    );
+
+    request->send(200, "application/json", json);
+}
@@ -11,52 +11,124 @@
 #ifndef WEB_APP_H
 #define WEB_APP_H
 
-#include <WebServer.h>
-
-class DFPlayerMini;
+#include <ESPAsyncWebServer.h>
+#include <mutex>
+#include <PlayerTask.h>
+#include "LogRing.h"
 
 
 class WebApp {
 public:
     /** 
      * Constructor for WebApp class.
-     * @param player Reference to the DFPlayerMini instance being used.
-     * @param log_buffer Reference to the global log buffer string (terminal messages).
+     * @param player Reference to the task that owns the DFPlayer (commands are submitted to it,
+     *               never run by the request handlers).
      */
-    explicit WebApp(DFPlayerMini& player, String& log_buffer);
+    explicit WebApp(PlayerTask& player);
 
     /**
      * Initializes the web application.
      * - Sets up routes
-     * - Starts the server
+     * - Starts the server (requests are handled as they arrive, from the AsyncTCP task)
      * - Configures mDNS
      */
     void begin();
 
-    /**
-     * Handles incoming client requests.
-     * Should be called repeatedly in the main loop.
-     */
-    void handle_client();
-
     /** 
-     * Logs a blank message to the web log buffer (UI terminal).
+     * Logs a blank message to the web log (UI terminal).
      */
     void log();
 
     /** 
-     * Logs a message to the web log buffer (UI terminal).
+     * Logs a message to the web log (UI terminal), truncated to `LOG_LINE_SIZE`.
      * @param msg The message to log.
      */
-    void log(String msg);
+    void log(const char* msg);
+    void log(const String& msg);
+
+    /** 
+     * Logs a `printf`-style message to the web log (UI terminal), formatted on the stack:
+     * nothing is allocated.
+     * @param format The format string.
+     */
+    void logf(const char* format, ...) __attribute__((format(printf, 2, 3)));
+
+    /**
+     * Reports the outcome of a command submitted by a request handler (logs failures
+     * and the end of a calibration run; acknowledges `/ws` commands).
+     * Called by whoever drains the completion channel.
+     * @param completion The outcome.
+     */
+    void handle_completion(const PlayerTask::Completion& completion);
+
+    /**
+     * Pushes what changed since the last call to the `/events` clients (new log lines, then the
+     * player state and DFPlayer health if they changed) and to the `/ws` clients (the state fields
+     * that changed, health). Called from the main loop.
+     */
+    void update();
 
     bool mDNS_is_setup = false; /**< Flag indicating if mDNS setup was successful */
 
 
 private:
-    WebServer _server;          /**< Web server instance for handling HTTP requests */
-    String& _log_buffer;        /**< Reference to the global log buffer string (terminal messages) */
-    DFPlayerMini& _player;      /**< Reference to the DFPlayerMini instance used in main */
+    static constexpr uint8_t       LATENCY_BUCKETS = 21;     /**< Handler time histogram: bucket `i` holds `[2^i, 2^(i+1))` us */
+    static constexpr unsigned long RATE_WINDOW_MS  = 10000;  /**< Window of the request rate */
+    static constexpr size_t        LOG_LINES       = 48;     /**< Lines kept for `/log` */
+    static constexpr size_t        LOG_LINE_SIZE   = 96;     /**< Longest line (with timestamp and `\0`) */
+    static constexpr size_t        WS_PENDING      = 16;     /**< `/ws` commands waiting for their completion */
+    static constexpr size_t        WS_MESSAGE_SIZE = 128;    /**< Longest `/ws` command message */
+    static constexpr unsigned long WS_TIMEOUT_MS   = 60000;  /**< `/ws` command given up on (calibration takes up to ~30 s) */
+
+    /**
+     * A `/ws` command submitted to the player task, acknowledged when it completes.
+     */
+    struct PendingAck {
+        uint32_t      command = 0;   /**< `PlayerTask` command id (`0`: free slot) */
+        uint32_t      client  = 0;   /**< Socket client */
+        uint32_t      id      = 0;   /**< The client's id for it */
+        unsigned long sent_ms = 0;   /**< `millis()` when submitted (see `WS_TIMEOUT_MS`) */
+    };
+
+    /**
+     * What the `/events` clients were last sent (only touched from the main loop).
+     */
+    struct Pushed {
+        bool             valid      = false;
+        uint32_t         log        = 0;      /**< Last log line */
+        dfplayer::State  state;
+        bool             confirmed  = false;  /**< `NowPlaying::confirmed` */
+        dfplayer::Health health     = dfplayer::Health::DISABLED;
+        bool             detected   = false;
+        uint32_t         outages    = 0;
+        uint32_t         recoveries = 0;
+        uint32_t         restarts   = 0;
+    };
+
+    /**
+     * Request counters for `/api/metrics` (only touched from the AsyncTCP task).
+     */
+    struct Metrics {
+        uint32_t      requests                 = 0;
+        uint32_t      not_found                = 0;
+        uint32_t      latency[LATENCY_BUCKETS] = {};  /**< Handler times (see `LATENCY_BUCKETS`) */
+        unsigned long max_us                   = 0;
+        unsigned long window_start_ms          = 0;
+        uint32_t      window_requests          = 0;
+        float         requests_per_s           = 0;   /**< Over the last complete window */
+        uint32_t      ws_messages              = 0;   /**< `/ws` commands received */
+    };
+
+    AsyncWebServer _server;     /**< Event-driven web server (runs in the AsyncTCP task) */
+    AsyncEventSource _events;   /**< `/events` (Server-Sent Events) */
+    AsyncWebSocket _ws;         /**< `/ws` (commands, acknowledgements, state changes) */
+    PlayerTask& _player;        /**< Reference to the task that owns the DFPlayer */
+    LogRing<LOG_LINES, LOG_LINE_SIZE> _log;  /**< Terminal messages, numbered */
+    std::mutex _log_mutex;      /**< Held while `_log` is used */
+    Metrics _metrics;           /**< Request counters */
+    Pushed _pushed;             /**< Last sent to the `/events` and `/ws` clients */
+    PendingAck _acks[WS_PENDING];  /**< `/ws` commands not yet acknowledged */
+    std::mutex _acks_mutex;     /**< Held while `_acks` is used */
 
     /** 
      * Sets up the mDNS responder (skips if WiFi is not connected).
@@ -70,6 +142,90 @@ private:
      * - Sets up dynamic endpoints for `/play`, `/status`, etc.
      */
     void setup_routes();
+
+    /**
+     * Registers a `GET` route whose handler time is recorded in the metrics.
+     * @param uri The path.
+     * @param handler The member function handling the request.
+     */
+    void route(const char* uri, void (WebApp::*handler)(AsyncWebServerRequest*));
+
+    /**
+     * Records one handled request in the metrics.
+     * @param elapsed_us Time spent in the handler.
+     */
+    void record(unsigned long elapsed_us);
+
+    /**
+     * Returns a percentile of the handler times (upper bound of its histogram bucket).
+     * @param p The percentile (0-100).
+     */
+    unsigned long latency_percentile(float p) const;
+
+    /**
+     * Submits a command to the player task and answers `202 Accepted` right away
+     * (`503` if its mailbox is full).
+     * @param request The request to answer.
+     * @param op The command.
+     * @param arg Its argument, if any.
+     * @param body The response body.
+     */
+    void submit(AsyncWebServerRequest* request, PlayerTask::Op op, int16_t arg = 0, const String& body = "OK");
+
+    /**
+     * Returns whether the DFPlayer is online, as seen by the health monitor.
+     * @param snapshot The player task's snapshot.
+     */
+    static bool is_online(const PlayerTask::Snapshot& snapshot);
+
+    /**
+     * Formats the state (`/state`, `state` event) or health (`/health`, `health` event) JSON.
+     * @param json Receives the JSON (truncated to `size`).
+     * @param size Size of `json`.
+     * @param snapshot The player task's snapshot.
+     */
+    void format_state(char* json, size_t size, const PlayerTask::Snapshot& snapshot) const;
+    void format_health(char* json, size_t size, const PlayerTask::Snapshot& snapshot) const;
+
+    /**
+     * Formats the `/ws` state message: only the fields that differ from what was last pushed
+     * (all of them before the first push).
+     * @param json Receives the JSON (truncated to `size`).
+     * @param size Size of `json`.
+     * @param snapshot The player task's snapshot.
+     */
+    void format_state_delta(char* json, size_t size, const PlayerTask::Snapshot& snapshot) const;
+
+    /**
+     * Sends a new `/events` client what it missed: the log lines after its `Last-Event-ID`,
+     * then the current state and health.
+     * @param client The client (already receiving `update()`'s broadcasts).
+     */
+    void handle_events_connect(AsyncEventSourceClient* client);
+
+    /**
+     * Handles `/ws` events: sends a new client the current state and health, and runs the
+     * command in each complete text message (see `handle_ws_command()`).
+     */
+    void handle_ws_event(AsyncWebSocketClient* client, AwsEventType type, void* arg, uint8_t* data, size_t len);
+
+    /**
+     * Runs one `/ws` command, `{"id":7,"op":"loop_track","args":[3]}` (`op`: a `PlayerTask::op_name()`,
+     * `args` optional). Invalid commands are acknowledged at once with an `error`; the others
+     * once the player task has taken them (see `handle_completion()`).
+     * @param client The socket client.
+     * @param message The message (`\0`-terminated).
+     */
+    void handle_ws_command(AsyncWebSocketClient* client, const char* message);
+
+    /**
+     * Sends a `/ws` acknowledgement, `{"id":7,"ok":true}` (with `"error":"..."` if not `ok`).
+     * @param client The socket client.
+     * @param id The client's id for the command.
+     * @param ok Whether the player took the command.
+     * @param error Why not.
+     */
+    void ack(uint32_t client, uint32_t id, bool ok, const char* error = nullptr);
     
 
     /* ↓↓↓↓↓ DYNAMIC ENDPOINTS ↓↓↓↓↓ */
@@ -77,98 +233,133 @@ private:
 
     /** 
      * Private handler for the `/log` endpoint.
-     * Returns the current log buffer contents.
+     * Returns the log lines newer than `since` (all of them without it), one per line, with
+     * the cursor to pass next time in `X-Log-Next` and the number of lines the caller missed
+     * (overwritten since) in `X-Log-Dropped`.
      */
-    void handle_log();
+    void handle_log(AsyncWebServerRequest* request);
 
     /** 
      * Private handler for unknown routes (404 Not Found).
      */
-    void handle_not_found();
+    void handle_not_found(AsyncWebServerRequest* request);
 
     /** 
      * Private handler for the `/play` endpoint.
      * Expects a `track` query parameter to specify which track to loop.
      */
-    void handle_play();
+    void handle_play(AsyncWebServerRequest* request);
     
     /** 
      * Private handler for the `/status` endpoint.
-     * Returns `1` if the DFPlayer is online, `0` otherwise.
+     * Returns `1` if the DFPlayer is online (as seen by the health monitor), `0` otherwise.
+     */
+    void handle_status(AsyncWebServerRequest* request);
+
+    /** 
+     * Private handler for the `/health` endpoint.
+     * Returns the DFPlayer health monitor's state and outage times as JSON
+     * (with `online`, as `/status`).
+     */
+    void handle_health(AsyncWebServerRequest* request);
+
+    /** 
+     * Private handler for the `/state` endpoint.
+     * Returns the DFPlayer's shadow state as JSON (no UART traffic), including the
+     * current track and how long ago the player confirmed it.
+     */
+    void handle_state(AsyncWebServerRequest* request);
+
+    /** 
+     * Private handler for the `/api/tracks` endpoint.
+     * Returns the SD card catalog as JSON, with the card fingerprint as `ETag`
+     * (`304 Not Modified` while the card is unchanged).
+     */
+    void handle_tracks(AsyncWebServerRequest* request);
+
+    /** 
+     * Private handler for the `/api/metrics` endpoint.
+     * Returns request counts, the request rate, handler time percentiles and heap use as JSON.
+     */
+    void handle_metrics(AsyncWebServerRequest* request);
+
+    /** 
+     * Private handler for the `/calibrate` endpoint.
+     * Starts measuring the DFPlayer's per-command timing (result in the log, saved to NVS).
      */
-    void handle_status();
+    void handle_calibrate(AsyncWebServerRequest* request);
 
     /** 
      * Private handler for the `/previous` endpoint.
      * Commands the DFPlayer to play the previous track.
      */
-    void handle_previous();
+    void handle_previous(AsyncWebServerRequest* request);
 
     /** 
      * Private handler for the `/pause` endpoint.
      * Commands the DFPlayer to pause playback.
      */
-    void handle_pause();
+    void handle_pause(AsyncWebServerRequest* request);
 
     /** 
      * Private handler for the `/resume` endpoint.
      * Commands the DFPlayer to resume playback.
      */
-    void handle_resume();
+    void handle_resume(AsyncWebServerRequest* request);
 
     /** 
      * Private handler for the `/next` endpoint.
      * Commands the DFPlayer to play the next track.
      */
-    void handle_next();
+    void handle_next(AsyncWebServerRequest* request);
 
     /** 
      * Private handler for the `/volume_down` endpoint.
      * Commands the DFPlayer to decrement the volume.
      */
-    void handle_volume_down();
+    void handle_volume_down(AsyncWebServerRequest* request);
 
     /** 
      * Private handler for the `/stop` endpoint.
      * Commands the DFPlayer to stop all playback.
      */
-    void handle_stop();
+    void handle_stop(AsyncWebServerRequest* request);
 
     /** 
      * Private handler for the `/volume_up` endpoint.
      * Commands the DFPlayer to increment the volume.
      */
-    void handle_volume_up();
+    void handle_volume_up(AsyncWebServerRequest* request);
 
     /** 
      * Private handler for the `/start_repeat` endpoint.
      * Commands the DFPlayer to start looping the current track.
      */
-    void handle_start_repeat();
+    void handle_start_repeat(AsyncWebServerRequest* request);
 
     /** 
      * Private handler for the `/stop_repeat` endpoint.
      * Commands the DFPlayer to stop looping the current track.
      */
-    void handle_stop_repeat();
+    void handle_stop_repeat(AsyncWebServerRequest* request);
 
     /** 
      * Private handler for the `/set_eq_normal` endpoint.
      * Sets the DFPlayer EQ to `Normal` mode.
      */
-    void handle_set_EQ_normal();
+    void handle_set_EQ_normal(AsyncWebServerRequest* request);
 
     /** 
      * Private handler for the `/set_eq_rock` endpoint.
      * Sets the DFPlayer EQ to `Rock` mode.
      */
-    void handle_set_EQ_rock();
+    void handle_set_EQ_rock(AsyncWebServerRequest* request);
 
     /** 
      * Private handler for the `/set_eq_pop` endpoint.
      * Sets the DFPlayer EQ to `Pop` mode.
      */
-    void handle_set_EQ_pop();
+    void handle_set_EQ_pop(AsyncWebServerRequest* request);
 };
 
 
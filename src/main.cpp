@@ -1,11 +1,12 @@
 #include <WiFi.h>
 #include <SPIFFS.h>
 #include <ESPmDNS.h>
-#include <WebServer.h>
 
 #include <WebApp.h>
 #include <config/wifi.h>
+#include <Commands.h>
 #include <DFPlayerMini.h>
+#include <PlayerTask.h>
 
 
 // Function prototypes
@@ -13,14 +14,18 @@ void connect_to_wifi();
 bool setup_DFPlayer();
 
 
-// Global log buffer for messages to server
-String log_buffer = "";
-
-
 // Globals for debug info on web app
 bool wifi_is_connected = false;
 String wifi_IP_address = "";
 bool DFPlayer_OK = false;
+unsigned long init_to_audio_ms = 0;  // From `DFPlayer.begin()` to the end of the init sequence (first audio)
+
+// DFPlayer health monitor: mean time between status probes when nothing else was heard
+constexpr unsigned long DFPLAYER_HEALTH_INTERVAL_MS = 5000;
+
+// DFPlayer now playing: track polls right after a change, backing off to the max. while it stays the same
+constexpr unsigned long DFPLAYER_TRACK_POLL_MIN_MS  = 500;
+constexpr unsigned long DFPLAYER_TRACK_POLL_MAX_MS  = 30000;
 
 
 // WiFi config
@@ -36,8 +41,11 @@ const uint8_t mcu_tx = D6;   // XIAO pin going TO MP3 RX
 // `DFPlayerMini` instance
 DFPlayerMini DFPlayer(mcu_rx, mcu_tx);
 
+// Owns `DFPlayer` once started: request handlers submit commands to it
+PlayerTask player_task(DFPlayer);
+
 // `WebApp` instance
-WebApp web_app(DFPlayer, log_buffer);
+WebApp web_app(player_task);
 
 
 
@@ -64,6 +72,11 @@ void setup()
     // 3) Start DFPlayer
     DFPlayer_OK = setup_DFPlayer();
 
+    // 4) Hand DFPlayer over to its task (commands submitted before now are sent first)
+    if (!player_task.start()) {
+        Serial.println("ERROR: DFPlayer task could not be started!");
+    }
+
     if (!DFPlayer_OK) {
         Serial.println("WARNING: System running without Audio hardware.");
     }
@@ -84,8 +97,16 @@ void setup()
 
 void loop()
 {
-    // Handle HTTP requests
-    web_app.handle_client();
+    // HTTP requests are handled as they arrive (AsyncTCP task), DFPlayer is polled by its own task
+
+    // Report the outcome of the commands they submitted
+    PlayerTask::Completion completion;
+    while (player_task.next_completion(completion)) {
+        web_app.handle_completion(completion);
+    }
+
+    // Push new log lines, state and health to the pages listening on `/events`
+    web_app.update();
 
     delay(10);
 }
@@ -140,28 +161,57 @@ void connect_to_wifi()
 
 bool setup_DFPlayer()
 {
+    // Sent back-to-back, each frame released as soon as the previous one is acknowledged.
+    // Arguments are range-checked at compile time against the command table.
+    using namespace dfplayer;
+    static constexpr Step init_sequence[] = {
+        step<op::SetSource>(arg<2>),       // SD card
+        step<op::SetVolume>(arg<30>),      // Volume 30
+        step<op::PowerOnVolume>(arg<30>),  // Power-on volume 30
+        step<op::LoopTrack>(arg<1>),       // Loop track 1
+    };
+
     Serial.println("Initializing DFPlayer...");
 
     Serial.println("Starting DFPlayer serial comms...");
-    DFPlayer.begin();
-    delay(700);
-
-    Serial.println("Selecting SD card (2) as source...");
-    DFPlayer.set_source(2);
-    delay(700);
-
-    Serial.println("Setting volume to 30...");
-    DFPlayer.set_volume(30);
-    delay(700);
-
-    Serial.println("Setting power-on volume to 30...");
-    DFPlayer.set_power_on_volume(30);
-    delay(700);
-
-    byte track_num = 1;
-    Serial.println("Looping track # " + String(track_num));
-    DFPlayer.loop_track(track_num);
-    delay(0);
-
-    return true;
-}
\ No newline at end of file
+    const unsigned long start_ms = millis();
+    const bool detected = DFPlayer.begin(false, true);
+    DFPlayer.set_ack_mode(true);
+
+    DFPlayer.on_event(dfplayer::cmd::QU_DEV_INSERTED, [](const dfplayer::Response&) {
+        web_app.log("DFPlayer: SD card inserted.");
+    });
+    DFPlayer.on_event(dfplayer::cmd::QU_DEV_UNPLUGGED, [](const dfplayer::Response&) {
+        web_app.log("DFPlayer: SD card removed!");
+    });
+    DFPlayer.on_event(dfplayer::cmd::QU_TF_SD_COMPL, [](const dfplayer::Response& event) {
+        web_app.log("DFPlayer: Finished track " + String(event.param));
+    });
+
+    Serial.println("Sending init sequence (source SD, volume 30, loop track 1)...");
+    DFPlayer.run_batch(init_sequence, sizeof(init_sequence) / sizeof(init_sequence[0]), [start_ms]() {
+        // Not counted from reset: WiFi and the rest of `setup()` would swamp the player's part
+        init_to_audio_ms = millis() - start_ms;
+        Serial.println("DFPlayer init sequence complete, init to first audio: " + String(init_to_audio_ms) + " ms");
+        web_app.log("DFPlayer: Init to first audio: " + String(init_to_audio_ms) + " ms");
+
+        // Check the card against the cached catalog (full scan only if it changed)
+        DFPlayer.scan_catalog([](bool ok, bool changed) {
+            const dfplayer::Catalog& catalog = DFPlayer.get_catalog();
+            if (!ok) {
+                web_app.log("DFPlayer: Catalog scan failed.");
+            } else if (changed) {
+                web_app.log("DFPlayer: Catalog updated: " + String(catalog.total_tracks) + " tracks, " +
+                            String(catalog.folder_count) + " folders");
+            }
+        });
+    });
+
+    // Probe the player in the background; after a glitch, reset it and replay the init sequence
+    DFPlayer.monitor(DFPLAYER_HEALTH_INTERVAL_MS, init_sequence, sizeof(init_sequence) / sizeof(init_sequence[0]));
+
+    // Follow the current track (polled quickly after a change, then less and less often)
+    DFPlayer.watch_track(DFPLAYER_TRACK_POLL_MIN_MS, DFPLAYER_TRACK_POLL_MAX_MS);
+
+    return detected;
+}